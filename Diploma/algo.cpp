@@ -1,83 +1,299 @@
 #include "algo.h"
 #include "factors.h"
 #include <cmath>
+#include <cstdlib>
 #include <algorithm>
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
 
 namespace algo {
 
     static Factors factors;
+    // Ranks of the threads backend are threads, each of them allocates its own arrays
+    static thread_local Arena solverArena;
 
-    Factors &ftr() {
+    const Factors &ftr() {
         return factors;
     }
 
-    void fillFactors(double *rw, double *brw, size_t size,
-                     double *aF, double *bF, double *cF, double *fF,
-                     double t, double hX, double dT,
-                     bool leftBorder, bool rightBorder)
+    void initFactors(const char *filename) {
+        factors.initFactors(filename);
+    }
+
+    Arena &arena() {
+        return solverArena;
+    }
+
+    RowConstants rowConstants(double t, double hX, double dT) {
+        RowConstants k;
+        k.hX = hX;
+        k.hh = hX * hX;
+        k.dT = dT;
+        k.alpha2 = 2 * hX * dT * factors.alpha(t);
+        k.sigma2 = 2 * hX * dT * factors.sigma(t);
+        k.alphaTEnv2 = k.alpha2 * factors.TEnv();
+        k.TEnv = factors.TEnv();
+        k.TEnv4 = factors.TEnv4();
+        return k;
+    }
+
+    // Runtime borders pick the kernel instantiation once per call
+    #define BORDERS_DISPATCH(kernel, ...) \
+        (leftBorder ? (rightBorder ? kernel<true, true>(__VA_ARGS__) : kernel<true, false>(__VA_ARGS__)) \
+                    : (rightBorder ? kernel<false, true>(__VA_ARGS__) : kernel<false, false>(__VA_ARGS__)))
+
+    /**
+     *  Right hand side of the correction form: `f` less the local part of `A * brw` around cell `x`.
+     */
+    static inline double corrected(double f, double a, double b, double c, const double *x, size_t pitch,
+                                   bool hasPrev, bool hasNext) {
+        f -= c * x[0];
+        if (hasPrev) {
+            f -= a * *(x - pitch);
+        }
+        if (hasNext) {
+            f -= b * x[pitch];
+        }
+        return f;
+    }
+
+    template <bool leftBorder, bool rightBorder, typename Storage>
+    static void fillFactorsT(double *rw, double *brw, size_t size,
+                             Storage *aF, Storage *bF, Storage *cF, Storage *fF,
+                             double *lm, double *rc, const RowConstants &k,
+                             size_t stride, size_t liquid, double *tc)
     {
-        double lm0 = factors.lambda(brw[0]), lmh = factors.lambda(brw[1]);
-        if (leftBorder) {
-            aF[0] = 0;
-            cF[0] = dT * (lm0 + lmh) + hX * hX * factors.ro(brw[0]) * factors.cEf(brw[0]);
-            bF[0] = -dT * (lm0 + lmh);
-            fF[0] = hX * hX * factors.ro(brw[0]) * factors.cEf(brw[0]) * rw[0];
+        size_t from = liquid > 0 ? liquid - 1 : 0;
+        if (tc != NULL) {
+            factors.evaluateChanged(brw + from, size - from, tc + from, lm + from, rc + from,
+                                    factors.PropertiesCacheTolerance());
+        } else {
+            factors.evaluate(brw + from, size - from, lm + from, rc + from);
+        }
+
+        bool const correction = sizeof(Storage) < sizeof(double);
+        size_t const local = size - (rightBorder ? 0 : 1);
+
+        double hh = k.hh, dT = k.dT;
+        double a, b, c, f;
+        if (leftBorder && liquid == 0) {
+            a = 0;
+            c = dT * (lm[0] + lm[1]) + hh * rc[0];
+            b = -dT * (lm[0] + lm[1]);
+            f = hh * rc[0] * rw[0];
+
+            aF[0] = a;
+            bF[0] = b;
+            cF[0] = c;
+            fF[0] = correction ? corrected(f, a, b, c, brw, 1, false, 1 < local) : f;
         }
 
         if (rightBorder) {
+            size_t last = (size - 1) * stride;
             double TPrev = brw[size - 1];
             double TPrev4 = TPrev * TPrev * TPrev * TPrev;
-            double lmXX = factors.lambda(brw[size - 1]), lmXXm1 = factors.lambda(brw[size - 2]);
+            double lmXX = lm[size - 1], lmXXm1 = lm[size - 2];
 
-            aF[size - 1] = -dT * (lmXXm1 + lmXX);
-            cF[size - 1] = dT * (lmXXm1 + lmXX)
-                    + hX * hX * factors.ro(brw[size - 1]) * factors.cEf(brw[size - 1])
-                    + 2 * hX * dT * factors.alpha(t);
-            bF[size - 1] = 0;
-            fF[size - 1] = hX * hX * factors.ro(brw[size - 1]) * factors.cEf(brw[size - 1]) * rw[size - 1]
-                    - 2 * hX * dT * factors.sigma(t) * (TPrev4 - factors.TEnv4())
-                    + 2 * hX * dT * factors.alpha(t) * factors.TEnv();
+            a = -dT * (lmXXm1 + lmXX);
+            c = dT * (lmXXm1 + lmXX)
+                    + hh * rc[size - 1]
+                    + k.alpha2;
+            b = 0;
+            f = hh * rc[size - 1] * rw[size - 1]
+                    - k.sigma2 * (TPrev4 - k.TEnv4)
+                    + k.alphaTEnv2;
+
+            aF[last] = a;
+            bF[last] = b;
+            cF[last] = c;
+            fF[last] = correction ? corrected(f, a, b, c, brw + size - 1, 1, true, false) : f;
         }
 
-        double lmXm1 = lm0, lmX = lmh, lmXp1;
         double mhh2rocdT;
-        for (size_t index = 1; index < size - 1; ++index) {
-            lmXp1 = factors.lambda(brw[index + 1]);
-            mhh2rocdT = - 2 * hX * hX * factors.ro(brw[index]) * factors.cEf(brw[index]) / dT;
+        size_t start = std::max<size_t>(liquid, 1);
+        for (size_t index = start, sIndex = start * stride; index < size - 1; ++index, sIndex += stride) {
+            mhh2rocdT = - 2 * hh * rc[index] / dT;
+
+            a = lm[index] + lm[index - 1];
+            b = lm[index + 1] + lm[index];
+            c = -(lm[index + 1] + 2 * lm[index] + lm[index - 1]) + mhh2rocdT;
+            f = mhh2rocdT * rw[index];
 
-            aF[index] = lmX + lmXm1;
-            bF[index] = lmXp1 + lmX;
-            cF[index] = -(lmXp1 + 2 * lmX + lmXm1) + mhh2rocdT;
-            fF[index] = mhh2rocdT * rw[index];
-            
-            lmXm1 = lmX;
-            lmX = lmXp1;
+            aF[sIndex] = a;
+            bF[sIndex] = b;
+            cF[sIndex] = c;
+            fF[sIndex] = correction ? corrected(f, a, b, c, brw + index, 1, true, index + 1 < local) : f;
         }
     }
 
-    void firstPass(size_t size, double *aF, double *bF, double *cF, double *fF, bool rightBorder) {
-        double m;
-        for (size_t i = 1, len = size - (rightBorder ? 0 : 1); i < len; ++i) {
-            m = aF[i] / cF[i - 1];
-            cF[i] -= m * bF[i - 1];
-            fF[i] -= m * fF[i - 1];
+    template <typename Storage>
+    void fillFactors(double *rw, double *brw, size_t size,
+                     Storage *aF, Storage *bF, Storage *cF, Storage *fF,
+                     double *lm, double *rc, const RowConstants &k,
+                     bool leftBorder, bool rightBorder, size_t stride, size_t liquid, double *tc)
+    {
+        BORDERS_DISPATCH(fillFactorsT, rw, brw, size, aF, bF, cF, fF, lm, rc, k, stride, liquid, tc);
+    }
+
+    // Batches are always double, the coefficients matrix is in `coefficient_t`
+    template void fillFactors<double>(double *, double *, size_t, double *, double *, double *, double *,
+                                      double *, double *, const RowConstants &, bool, bool, size_t, size_t, double *);
+    template void fillFactors<float>(double *, double *, size_t, float *, float *, float *, float *,
+                                     double *, double *, const RowConstants &, bool, bool, size_t, size_t, double *);
+
+    template <bool leftBorder, bool rightBorder, typename Storage>
+    static void fillNewtonFactorsT(double *rw, double *brw, size_t size,
+                                   Storage *aF, Storage *bF, Storage *cF, Storage *fF,
+                                   double *lm, double *rc, double *dlm, double *drc,
+                                   const RowConstants &k, size_t stride, size_t liquid)
+    {
+        // Liquid equations are linear, so their Newton system is the Picard one
+        size_t from = liquid > 0 ? liquid - 1 : 0;
+        factors.evaluateDerivatives(brw + from, size - from, lm + from, rc + from, dlm + from, drc + from);
+
+        bool const correction = sizeof(Storage) < sizeof(double);
+        size_t const local = size - (rightBorder ? 0 : 1);
+
+        double hh = k.hh, dT = k.dT;
+        double F, a, b, c, f;
+        if (leftBorder && liquid == 0) {
+            double S = lm[0] + lm[1], d = brw[0] - brw[1];
+            F = dT * S * d + hh * rc[0] * (brw[0] - rw[0]);
+
+            a = 0;
+            c = dT * S + dT * dlm[0] * d + hh * rc[0] + hh * drc[0] * (brw[0] - rw[0]);
+            b = -dT * S + dT * dlm[1] * d;
+            f = c * brw[0] + b * brw[1] - F;
+
+            aF[0] = a;
+            bF[0] = b;
+            cF[0] = c;
+            fF[0] = correction ? corrected(f, a, b, c, brw, 1, false, 1 < local) : f;
+        }
+
+        if (rightBorder) {
+            size_t n = size - 1, last = n * stride;
+            double T = brw[n];
+            double T3 = T * T * T;
+            double S = lm[n - 1] + lm[n], d = brw[n] - brw[n - 1];
+            F = dT * S * d + hh * rc[n] * (T - rw[n])
+                    + k.alpha2 * (T - k.TEnv)
+                    + k.sigma2 * (T3 * T - k.TEnv4);
+
+            a = -dT * S + dT * dlm[n - 1] * d;
+            c = dT * S + dT * dlm[n] * d
+                    + hh * rc[n] + hh * drc[n] * (T - rw[n])
+                    + k.alpha2 + 4 * k.sigma2 * T3;
+            b = 0;
+            f = a * brw[n - 1] + c * T - F;
+
+            aF[last] = a;
+            bF[last] = b;
+            cF[last] = c;
+            fF[last] = correction ? corrected(f, a, b, c, brw + n, 1, true, false) : f;
+        }
+
+        double dl, dr, m, dm;
+        size_t start = std::max<size_t>(liquid, 1);
+        for (size_t index = start, sIndex = start * stride; index < size - 1; ++index, sIndex += stride) {
+            dl = brw[index - 1] - brw[index];
+            dr = brw[index + 1] - brw[index];
+            m = - 2 * hh * rc[index] / dT;
+            dm = - 2 * hh * drc[index] / dT;
+            F = (lm[index] + lm[index - 1]) * dl + (lm[index + 1] + lm[index]) * dr + m * (brw[index] - rw[index]);
+
+            a = lm[index] + lm[index - 1] + dlm[index - 1] * dl;
+            b = lm[index + 1] + lm[index] + dlm[index + 1] * dr;
+            c = -(lm[index + 1] + 2 * lm[index] + lm[index - 1])
+                    + dlm[index] * (dl + dr) + m + dm * (brw[index] - rw[index]);
+            f = a * brw[index - 1] + c * brw[index] + b * brw[index + 1] - F;
+
+            aF[sIndex] = a;
+            bF[sIndex] = b;
+            cF[sIndex] = c;
+            fF[sIndex] = correction ? corrected(f, a, b, c, brw + index, 1, true, index + 1 < local) : f;
         }
     }
 
-    void secondPass(double *rw, double *brw, size_t size,
-                    double *bF, double *cF, double *fF,
-                    bool rightBorder, double *maxDelta) {
+    template <typename Storage>
+    void fillNewtonFactors(double *rw, double *brw, size_t size,
+                           Storage *aF, Storage *bF, Storage *cF, Storage *fF,
+                           double *lm, double *rc, double *dlm, double *drc,
+                           const RowConstants &k,
+                           bool leftBorder, bool rightBorder, size_t stride, size_t liquid)
+    {
+        BORDERS_DISPATCH(fillNewtonFactorsT, rw, brw, size, aF, bF, cF, fF, lm, rc, dlm, drc, k, stride, liquid);
+    }
+
+    template void fillNewtonFactors<double>(double *, double *, size_t, double *, double *, double *, double *,
+                                            double *, double *, double *, double *, const RowConstants &,
+                                            bool, bool, size_t, size_t);
+    template void fillNewtonFactors<float>(double *, double *, size_t, float *, float *, float *, float *,
+                                           double *, double *, double *, double *, const RowConstants &,
+                                           bool, bool, size_t, size_t);
+
+    template <bool rightBorder>
+    static void firstPassT(size_t size, coefficient_t *aF, coefficient_t *bF, coefficient_t *cF, coefficient_t *fF,
+                           size_t from) {
+        size_t const s = kCoefficientsStride;
+        size_t i = std::max<size_t>(from, 1);
+
+        // Eliminated c and f of the previous equation are carried in double, whatever the storage
+        double m, b = bF[(i - 1) * s], c = cF[(i - 1) * s], f = fF[(i - 1) * s];
+        for (size_t len = size - (rightBorder ? 0 : 1); i < len; ++i) {
+            m = aF[i * s] / c;
+            c = cF[i * s] - m * b;
+            f = fF[i * s] - m * f;
+            b = bF[i * s];
+            cF[i * s] = c;
+            fF[i * s] = f;
+        }
+    }
+
+    void firstPass(size_t size, coefficient_t *aF, coefficient_t *bF, coefficient_t *cF, coefficient_t *fF,
+                   bool rightBorder, size_t from) {
+        if (rightBorder) {
+            firstPassT<true>(size, aF, bF, cF, fF, from);
+        } else {
+            firstPassT<false>(size, aF, bF, cF, fF, from);
+        }
+    }
+
+    template <bool rightBorder>
+    static void secondPassT(double *rw, double *brw, size_t size,
+                            coefficient_t *bF, coefficient_t *cF, coefficient_t *fF, double *maxDelta) {
+        size_t const s = kCoefficientsStride;
         *maxDelta = 0;
 
+        if (kCorrectionCoefficients) {
+            // Corrections to `rw` are carried, the halo after the row is a value
+            double d = rightBorder ? 0 : brw[size - 1];
+            if (rightBorder) {
+                d = fF[(size - 1) * s] / cF[(size - 1) * s];
+                *maxDelta = fabs(d);
+                brw[size - 1] = rw[size - 1] + d;
+            }
+
+            for (long i = size - 2; i >= 0; --i) {
+                d = (fF[i * s] - bF[i * s] * d) / cF[i * s];
+
+                double newValue = rw[i] + d;
+                *maxDelta = std::max(*maxDelta, fabs(newValue - rw[i]));
+                brw[i] = newValue;
+            }
+            return;
+        }
+
         double newValue = 0;
         if (rightBorder) {
-            newValue = fF[size - 1] / cF[size - 1];
+            newValue = fF[(size - 1) * s] / cF[(size - 1) * s];
             *maxDelta = fabs(newValue - rw[size - 1]);
             brw[size - 1] = newValue;
         }
 
         for (long i = size - 2; i >= 0; --i) {
-            newValue = (fF[i] - bF[i] * brw[i + 1]) / cF[i];
+            newValue = (fF[i * s] - bF[i * s] * brw[i + 1]) / cF[i * s];
 
             double newDelta = fabs(newValue - rw[i]);
             *maxDelta = std::max(*maxDelta, newDelta);
@@ -85,4 +301,384 @@ namespace algo {
         }
     }
 
-}
\ No newline at end of file
+    void secondPass(double *rw, double *brw, size_t size,
+                    coefficient_t *bF, coefficient_t *cF, coefficient_t *fF,
+                    bool rightBorder, double *maxDelta) {
+        if (rightBorder) {
+            secondPassT<true>(rw, brw, size, bF, cF, fF, maxDelta);
+        } else {
+            secondPassT<false>(rw, brw, size, bF, cF, fF, maxDelta);
+        }
+    }
+
+#pragma mark - Liquid
+
+    void factorLiquid(LiquidFactors &lq, size_t size, double hX, double dT) {
+        double hh = hX * hX;
+        double lm = factors.liquidLambda();
+        double rc = factors.liquidRoC();
+
+        lq.hX = hX;
+        lq.dT = dT;
+        lq.hhroc = hh * rc;
+        lq.b0 = -dT * 2 * lm;
+        lq.b = 2 * lm;
+        lq.m = - 2 * hh * rc / dT;
+        lq.cF.resize(size);
+        lq.mF.resize(size);
+
+        // Same equations as `fillFactors` with a left border, eliminated as in `firstPass`
+        double c = -4 * lm + lq.m;
+        lq.cF[0] = dT * 2 * lm + lq.hhroc;
+        lq.mF[0] = 0;
+        for (size_t i = 1; i < size; ++i) {
+            lq.mF[i] = lq.b / lq.cF[i - 1];
+            lq.cF[i] = c - lq.mF[i] * (i == 1 ? lq.b0 : lq.b);
+        }
+    }
+
+    size_t liquidEquations(const double *brw, size_t size) {
+        double TLik = factors.TLiquidus();
+        size_t cells = 0;
+        while (cells < size && brw[cells] >= TLik) {
+            ++cells;
+        }
+        return cells > 1 ? cells - 1 : 0;
+    }
+
+    template <typename Storage>
+    void fillLiquid(const LiquidFactors &lq, double *rw, double *brw, size_t count,
+                    Storage *aF, Storage *bF, Storage *cF, Storage *fF, size_t stride) {
+        if (count == 0) {
+            return;
+        }
+
+        // Equations are eliminated, so the local part of `A * brw` is `c' * brw[i] + b * brw[i + 1]`
+        bool const correction = sizeof(Storage) < sizeof(double);
+
+        aF[0] = 0;
+        bF[0] = lq.b0;
+        cF[0] = lq.cF[0];
+        double f = lq.hhroc * rw[0];
+        fF[0] = correction ? corrected(f, 0, lq.b0, lq.cF[0], brw, 1, false, true) : f;
+        for (size_t index = 1, sIndex = stride; index < count; ++index, sIndex += stride) {
+            f = lq.m * rw[index] - lq.mF[index] * f;
+            aF[sIndex] = 0;
+            bF[sIndex] = lq.b;
+            cF[sIndex] = lq.cF[index];
+            fF[sIndex] = correction ? corrected(f, 0, lq.b, lq.cF[index], brw + index, 1, false, true) : f;
+        }
+    }
+
+    template void fillLiquid<double>(const LiquidFactors &, double *, double *, size_t,
+                                     double *, double *, double *, double *, size_t);
+    template void fillLiquid<float>(const LiquidFactors &, double *, double *, size_t,
+                                    float *, float *, float *, float *, size_t);
+
+#pragma mark - Fused
+
+    void fillProperties(double *brw, size_t size, double *lm, double *rc) {
+        factors.evaluate(brw, size, lm, rc);
+    }
+
+    void fusedFirstPass(double *rw, double *brw, size_t size,
+                        double *lm, double *rc, double *pF, double *qF,
+                        const RowConstants &k)
+    {
+        double hh = k.hh, dT = k.dT;
+
+        double c = dT * (lm[0] + lm[1]) + hh * rc[0];
+        pF[0] = -dT * (lm[0] + lm[1]) / c;
+        qF[0] = hh * rc[0] * rw[0] / c;
+
+        double a, b, f, den;
+        double mhh2rocdT;
+        for (size_t index = 1; index < size - 1; ++index) {
+            mhh2rocdT = - 2 * hh * rc[index] / dT;
+
+            a = lm[index] + lm[index - 1];
+            b = lm[index + 1] + lm[index];
+            c = -(lm[index + 1] + 2 * lm[index] + lm[index - 1]) + mhh2rocdT;
+            f = mhh2rocdT * rw[index];
+
+            den = c - a * pF[index - 1];
+            pF[index] = b / den;
+            qF[index] = (f - a * qF[index - 1]) / den;
+        }
+
+        size_t last = size - 1;
+        double TPrev = brw[last];
+        double TPrev4 = TPrev * TPrev * TPrev * TPrev;
+
+        a = -dT * (lm[last - 1] + lm[last]);
+        c = dT * (lm[last - 1] + lm[last]) + hh * rc[last] + k.alpha2;
+        f = hh * rc[last] * rw[last]
+                - k.sigma2 * (TPrev4 - k.TEnv4)
+                + k.alphaTEnv2;
+
+        den = c - a * pF[last - 1];
+        pF[last] = 0;
+        qF[last] = (f - a * qF[last - 1]) / den;
+    }
+
+    void fusedSecondPass(double *rw, double *brw, size_t size,
+                         double *pF, double *qF, double *lm, double *rc, double *maxDelta) {
+        *maxDelta = 0;
+
+        double newValue = 0;
+        for (long i = size - 1; i >= 0; --i) {
+            newValue = qF[i] - pF[i] * newValue;
+
+            double newDelta = fabs(newValue - rw[i]);
+            *maxDelta = std::max(*maxDelta, newDelta);
+            brw[i] = newValue;
+
+            lm[i] = factors.lambda(newValue);
+            rc[i] = factors.roC(newValue);
+        }
+    }
+
+#pragma mark - Batched
+
+    static inline batch_t abs(batch_t x) {
+        batch_t zero = {};
+        return batchSelect(x < zero, -x, x);
+    }
+
+    batch_t *allocBatch(size_t size) {
+        static_assert(sizeof(batch_t) <= Arena::kAlignment, "Arena blocks are not aligned for batch_t");
+        return (batch_t *)solverArena.alloc(Arena::kBatches, size * sizeof(batch_t));
+    }
+
+    void freeBatch(batch_t *batch) {
+        solverArena.release(batch);
+    }
+
+    void firstPassBatch(size_t size, batch_t *aF, batch_t *bF, batch_t *cF, batch_t *fF, bool rightBorder, size_t from) {
+        batch_t m;
+        for (size_t i = std::max<size_t>(from, 1), len = size - (rightBorder ? 0 : 1); i < len; ++i) {
+            m = aF[i] / cF[i - 1];
+            cF[i] -= m * bF[i - 1];
+            fF[i] -= m * fF[i - 1];
+        }
+    }
+
+    void secondPassBatch(batch_t *y, size_t size,
+                         batch_t *bF, batch_t *cF, batch_t *fF,
+                         bool rightBorder, const batch_mask_t &active, batch_t *maxDelta) {
+        batch_t zero = {};
+        batch_t delta = zero;
+
+        batch_t newValue = y[size - 1];
+        if (rightBorder) {
+            newValue = batchSelect(active, fF[size - 1] / cF[size - 1], y[size - 1]);
+            delta = abs(newValue - y[size - 1]);
+            y[size - 1] = newValue;
+        }
+
+        for (long i = size - 2; i >= 0; --i) {
+            newValue = batchSelect(active, (fF[i] - bF[i] * newValue) / cF[i], y[i]);
+
+            batch_t newDelta = abs(newValue - y[i]);
+            delta = batchSelect(newDelta > delta, newDelta, delta);
+            y[i] = newValue;
+        }
+
+        *maxDelta = delta;
+    }
+
+#pragma mark - Columns
+
+    void fillColumns(double *rw, double *brw, size_t size, size_t count, size_t pitch,
+                     coefficient_t *aF, coefficient_t *bF, coefficient_t *cF, coefficient_t *fF,
+                     double *lm[3], double *rc[2], const RowConstants &k,
+                     bool leftBorder, bool rightBorder)
+    {
+        size_t const s = kCoefficientsStride;
+        bool const correction = kCorrectionCoefficients;
+        size_t const local = size - (rightBorder ? 0 : 1);
+        double hh = k.hh, dT = k.dT;
+
+        // Properties of three consecutive rows are kept, the next one is evaluated as the sweep goes
+        double *lmPrev = lm[0], *lmCur = lm[1], *lmNext = lm[2];
+        double *rcCur = rc[0], *rcNext = rc[1];
+        factors.evaluate(brw, count, lmCur, rcCur);
+        factors.evaluate(brw + pitch, count, lmNext, rcNext);
+
+        if (leftBorder) {
+            for (size_t c = 0, sc = 0; c < count; ++c, sc += s) {
+                double lm01 = lmCur[c] + lmNext[c];
+                double cc = dT * lm01 + hh * rcCur[c], b = -dT * lm01, f = hh * rcCur[c] * rw[c];
+                aF[sc] = 0;
+                cF[sc] = cc;
+                bF[sc] = b;
+                fF[sc] = correction ? corrected(f, 0, b, cc, brw + c, pitch, false, 1 < local) : f;
+            }
+        }
+
+        for (size_t index = 1; index < size - 1; ++index) {
+            std::swap(lmPrev, lmCur);
+            std::swap(lmCur, lmNext);
+            std::swap(rcCur, rcNext);
+            factors.evaluate(brw + (index + 1) * pitch, count, lmNext, rcNext);
+
+            size_t offset = index * pitch;
+            coefficient_t *a = aF + offset * s, *b = bF + offset * s, *cc = cF + offset * s, *f = fF + offset * s;
+            const double *r = rw + offset, *br = brw + offset;
+            bool hasNext = index + 1 < local;
+            for (size_t c = 0, sc = 0; c < count; ++c, sc += s) {
+                double mhh2rocdT = - 2 * hh * rcCur[c] / dT;
+
+                double av = lmCur[c] + lmPrev[c];
+                double bv = lmNext[c] + lmCur[c];
+                double cv = -(lmNext[c] + 2 * lmCur[c] + lmPrev[c]) + mhh2rocdT;
+                double fv = mhh2rocdT * r[c];
+                a[sc] = av;
+                b[sc] = bv;
+                cc[sc] = cv;
+                f[sc] = correction ? corrected(fv, av, bv, cv, br + c, pitch, true, hasNext) : fv;
+            }
+        }
+
+        if (rightBorder) {
+            size_t offset = (size - 1) * pitch;
+            coefficient_t *a = aF + offset * s, *b = bF + offset * s, *cc = cF + offset * s, *f = fF + offset * s;
+            const double *r = rw + offset, *br = brw + offset;
+            for (size_t c = 0, sc = 0; c < count; ++c, sc += s) {
+                double TPrev = br[c];
+                double TPrev4 = TPrev * TPrev * TPrev * TPrev;
+                double lmXX = lmCur[c] + lmNext[c];
+
+                double av = -dT * lmXX;
+                double cv = dT * lmXX + hh * rcNext[c] + k.alpha2;
+                double fv = hh * rcNext[c] * r[c] - k.sigma2 * (TPrev4 - k.TEnv4) + k.alphaTEnv2;
+                a[sc] = av;
+                cc[sc] = cv;
+                b[sc] = 0;
+                f[sc] = correction ? corrected(fv, av, 0, cv, br + c, pitch, true, false) : fv;
+            }
+        }
+    }
+
+    void firstPassColumns(size_t size, size_t count, size_t pitch,
+                          coefficient_t *aF, coefficient_t *bF, coefficient_t *cF, coefficient_t *fF, bool rightBorder,
+                          double *c, double *f) {
+        size_t const s = kCoefficientsStride;
+        for (size_t j = 0, sj = 0; j < count; ++j, sj += s) {
+            c[j] = cF[sj];
+            f[j] = fF[sj];
+        }
+
+        for (size_t i = 1, len = size - (rightBorder ? 0 : 1); i < len; ++i) {
+            size_t cur = i * pitch * s, prv = (i - 1) * pitch * s;
+            for (size_t j = 0, sj = 0; j < count; ++j, sj += s) {
+                double m = aF[cur + sj] / c[j];
+                c[j] = cF[cur + sj] - m * bF[prv + sj];
+                f[j] = fF[cur + sj] - m * f[j];
+                cF[cur + sj] = c[j];
+                fF[cur + sj] = f[j];
+            }
+        }
+    }
+
+    void secondPassColumns(double *rw, double *brw, size_t size, size_t count, size_t pitch,
+                           coefficient_t *bF, coefficient_t *cF, coefficient_t *fF,
+                           bool rightBorder, double *maxDelta, double *d) {
+        size_t const s = kCoefficientsStride;
+        std::fill(maxDelta, maxDelta + count, 0.0);
+
+        if (kCorrectionCoefficients) {
+            // Corrections to `rw` are carried in `d`, the halo after the columns is a value
+            size_t offset = (size - 1) * pitch;
+            for (size_t c = 0, sc = offset * s; c < count; ++c, sc += s) {
+                d[c] = rightBorder ? fF[sc] / cF[sc] : brw[offset + c];
+                if (rightBorder) {
+                    maxDelta[c] = fabs(d[c]);
+                    brw[offset + c] = rw[offset + c] + d[c];
+                }
+            }
+
+            for (long i = size - 2; i >= 0; --i) {
+                offset = i * pitch;
+                for (size_t c = 0, sc = offset * s; c < count; ++c, sc += s) {
+                    d[c] = (fF[sc] - bF[sc] * d[c]) / cF[sc];
+                    double newValue = rw[offset + c] + d[c];
+                    maxDelta[c] = std::max(maxDelta[c], fabs(newValue - rw[offset + c]));
+                    brw[offset + c] = newValue;
+                }
+            }
+            return;
+        }
+
+        if (rightBorder) {
+            size_t offset = (size - 1) * pitch;
+            for (size_t c = 0, sc = offset * s; c < count; ++c, sc += s) {
+                double newValue = fF[sc] / cF[sc];
+                maxDelta[c] = fabs(newValue - rw[offset + c]);
+                brw[offset + c] = newValue;
+            }
+        }
+
+        for (long i = size - 2; i >= 0; --i) {
+            size_t offset = i * pitch;
+            const double *next = brw + offset + pitch;
+            for (size_t c = 0, sc = offset * s; c < count; ++c, sc += s) {
+                double newValue = (fF[sc] - bF[sc] * next[c]) / cF[sc];
+                double newDelta = fabs(newValue - rw[offset + c]);
+                maxDelta[c] = std::max(maxDelta[c], newDelta);
+                brw[offset + c] = newValue;
+            }
+        }
+    }
+
+#pragma mark - Transpose
+
+    static void transposeTile(const double *src, double *dst, size_t srcPitch, size_t dstPitch,
+                              size_t fromRow, size_t toRow, size_t fromCol, size_t toCol) {
+        size_t row = fromRow;
+#ifdef __AVX__
+        for (; row + 4 <= toRow; row += 4) {
+            size_t col = fromCol;
+            for (; col + 4 <= toCol; col += 4) {
+                const double *s = src + row * srcPitch + col;
+                __m256d r0 = _mm256_loadu_pd(s);
+                __m256d r1 = _mm256_loadu_pd(s + srcPitch);
+                __m256d r2 = _mm256_loadu_pd(s + 2 * srcPitch);
+                __m256d r3 = _mm256_loadu_pd(s + 3 * srcPitch);
+
+                __m256d t0 = _mm256_unpacklo_pd(r0, r1);
+                __m256d t1 = _mm256_unpackhi_pd(r0, r1);
+                __m256d t2 = _mm256_unpacklo_pd(r2, r3);
+                __m256d t3 = _mm256_unpackhi_pd(r2, r3);
+
+                double *d = dst + col * dstPitch + row;
+                _mm256_storeu_pd(d, _mm256_permute2f128_pd(t0, t2, 0x20));
+                _mm256_storeu_pd(d + dstPitch, _mm256_permute2f128_pd(t1, t3, 0x20));
+                _mm256_storeu_pd(d + 2 * dstPitch, _mm256_permute2f128_pd(t0, t2, 0x31));
+                _mm256_storeu_pd(d + 3 * dstPitch, _mm256_permute2f128_pd(t1, t3, 0x31));
+            }
+            for (; col < toCol; ++col) {
+                for (size_t r = row; r < row + 4; ++r) {
+                    dst[col * dstPitch + r] = src[r * srcPitch + col];
+                }
+            }
+        }
+#endif
+        for (; row < toRow; ++row) {
+            for (size_t col = fromCol; col < toCol; ++col) {
+                dst[col * dstPitch + row] = src[row * srcPitch + col];
+            }
+        }
+    }
+
+    void transpose(const double *src, double *dst, size_t height, size_t width, size_t srcPitch, size_t dstPitch) {
+        // Strips of columns are outer: rows of `dst` are then filled sequentially, tile after tile
+        for (size_t col = 0; col < width; col += kTransposeTile) {
+            size_t toCol = std::min(col + kTransposeTile, width);
+            for (size_t row = 0; row < height; row += kTransposeTile) {
+                transposeTile(src, dst, srcPitch, dstPitch, row, std::min(row + kTransposeTile, height), col, toCol);
+            }
+        }
+    }
+
+}
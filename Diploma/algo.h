@@ -6,22 +6,212 @@
 #define algo_h
 
 #include "factors.h"
+#include "arena.h"
 
 namespace algo {
 
-    Factors &ftr();
+    size_t const kBatchLanes = BATCH_LANES;
 
+    /**
+     *  Layout of row coefficients: with COEFFICIENTS_AOS the a, b, c and f of a cell are one
+     *  32-byte record, otherwise they are four separate arrays. Element `i` is at `[i * kCoefficientsStride]`.
+     */
+#ifdef COEFFICIENTS_AOS
+    size_t const kCoefficientsStride = 4;
+#else
+    size_t const kCoefficientsStride = 1;
+#endif
+
+    /**
+     *  Storage of row coefficients. With COEFFICIENTS_FLOAT they are kept in float to halve
+     *  the bytes streamed per cell; kernels still compute, eliminate and substitute in double.
+     */
+#ifdef COEFFICIENTS_FLOAT
+    typedef float coefficient_t;
+#else
+    typedef double coefficient_t;
+#endif
+
+    /**
+     *  Float coefficients are kept in the correction form: `fF` is the right hand side less the local
+     *  part of `A * brw` and the passes solve for `T - brw`, so rounding of the coefficients changes
+     *  the step but not the converged solution. The halo cell after a row without the right border
+     *  is not local: equations keep it as a value. Batches are double and always in the plain form.
+     */
+    bool const kCorrectionCoefficients = sizeof(coefficient_t) < sizeof(double);
+
+    using ::batch_t;
+    using ::batch_mask_t;
+
+    /**
+     *  Factors are read only once `initFactors` returned, so solver threads share them without locks.
+     */
+    const Factors &ftr();
+    void initFactors(const char *filename);
+
+    /**
+     *  Allocator of the solver arrays of this rank. Ranks that are threads have one each.
+     */
+    Arena &arena();
+
+    /**
+     *  Constants of row equations for one half step. Boundary zone coefficients at time `t`
+     *  are folded in once, so kernels do not call into `Factors` for them.
+     */
+    struct RowConstants {
+        double hX, hh, dT;
+        double alpha2, sigma2, alphaTEnv2;  // 2 * hX * dT * alpha(t), 2 * hX * dT * sigma(t), alpha2 * TEnv
+        double TEnv, TEnv4;
+    };
+
+    RowConstants rowConstants(double t, double hX, double dT);
+
+    /**
+     *  Evaluates properties of `brw` into `lm` and `rc` with one batch call, then assembles coefficients.
+     *  First `liquid` equations are expected to be filled by `fillLiquid` and are skipped.
+     *  With `tc` the properties in `lm` and `rc` are a cache computed at `tc` and refreshed by `evaluateChanged`.
+     */
+    template <typename Storage>
     void fillFactors(double *rw, double *brw, size_t size,
-                     double *aF, double *bF, double *cF, double *fF,
-                     double t, double hX, double dT,
-                     bool leftBorder, bool rightBorder);
+                     Storage *aF, Storage *bF, Storage *cF, Storage *fF,
+                     double *lm, double *rc, const RowConstants &k,
+                     bool leftBorder, bool rightBorder, size_t stride = 1, size_t liquid = 0, double *tc = NULL);
+
+    /**
+     *  Newton linearization of the row equations around `brw`: coefficients are the Jacobian
+     *  of lambda(T), ro(T) * cEf(T) and the radiative T^4 term, and `fF = J * brw - F(brw)`.
+     *  The system is solved for the next iterate, so `firstPass` and `secondPass` are reused as is.
+     */
+    template <typename Storage>
+    void fillNewtonFactors(double *rw, double *brw, size_t size,
+                           Storage *aF, Storage *bF, Storage *cF, Storage *fF,
+                           double *lm, double *rc, double *dlm, double *drc,
+                           const RowConstants &k,
+                           bool leftBorder, bool rightBorder, size_t stride = 1, size_t liquid = 0);
+
+    /**
+     *  Elimination starts at `from`, equations before it are already eliminated.
+     *  Coefficients are in the `kCoefficientsStride` layout, as are those of `secondPass`.
+     */
+    void firstPass(size_t size, coefficient_t *aF, coefficient_t *bF, coefficient_t *cF, coefficient_t *fF,
+                   bool rightBorder, size_t from = 1);
 
-    void firstPass(size_t size, double *aF, double *bF, double *cF, double *fF, bool rightBorder);
-    
     void secondPass(double *rw, double *brw, size_t size,
-                    double *bF, double *cF, double *fF,
+                    coefficient_t *bF, coefficient_t *cF, coefficient_t *fF,
                     bool rightBorder, double *maxDelta);
 
+#pragma mark - Liquid
+
+    /**
+     *  Equations of a liquid row prefix have constant coefficients (only the left border is allowed),
+     *  so their forward elimination depends on `hX` and `dT` only and is computed once.
+     */
+    struct LiquidFactors {
+        double hX, dT;
+        double b0, b, m, hhroc;
+        std::vector<double> cF, mF;
+    };
+
+    void factorLiquid(LiquidFactors &lq, size_t size, double hX, double dT);
+
+    /**
+     *  Count of leading equations with liquid coefficients: equation `i` needs cells `i - 1 .. i + 1`
+     *  at or above the liquidus. Zero when less than two cells are liquid.
+     */
+    size_t liquidEquations(const double *brw, size_t size);
+
+    /**
+     *  Writes already eliminated equations `[0, count)` for the right hand side `rw`.
+     *  Their `aF` is zero, so elimination of a batch with other lanes leaves them as is.
+     *  Cell `count` must be local, it is taken from `brw` in the correction form.
+     */
+    template <typename Storage>
+    void fillLiquid(const LiquidFactors &lq, double *rw, double *brw, size_t count,
+                    Storage *aF, Storage *bF, Storage *cF, Storage *fF, size_t stride = 1);
+
+#pragma mark - Fused
+
+    /**
+     *  Properties of the current iteration: `lm` is lambda(T), `rc` is ro(T) * cEf(T).
+     */
+    void fillProperties(double *brw, size_t size, double *lm, double *rc);
+
+    /**
+     *  Builds coefficients from cached properties and eliminates them in the same sweep.
+     *  Stores only the normalized `pF = b / c'` and `qF = f' / c'`. Both borders are required.
+     */
+    void fusedFirstPass(double *rw, double *brw, size_t size,
+                        double *lm, double *rc, double *pF, double *qF,
+                        const RowConstants &k);
+
+    /**
+     *  Back substitution that also refreshes `lm` and `rc` for the next iteration.
+     */
+    void fusedSecondPass(double *rw, double *brw, size_t size,
+                         double *pF, double *qF, double *lm, double *rc, double *maxDelta);
+
+#pragma mark - Batched
+
+    /**
+     *  Rows of a batch are interleaved: value of cell `i` for lane `l` is at `[i * kBatchLanes + l]`,
+     *  so that one `batch_t` holds the same cell of every row in the batch.
+     */
+    batch_t *allocBatch(size_t size);
+    void freeBatch(batch_t *batch);
+
+    void firstPassBatch(size_t size, batch_t *aF, batch_t *bF, batch_t *cF, batch_t *fF, bool rightBorder, size_t from = 1);
+
+    /**
+     *  Back substitution for all lanes at once.
+     *
+     *  @param y        previous values on input, new values on output
+     *  @param active   lanes with all bits set are updated, others keep their values in `y`
+     *  @param maxDelta per lane max |new - previous| (zero for inactive lanes)
+     */
+    void secondPassBatch(batch_t *y, size_t size,
+                         batch_t *bF, batch_t *cF, batch_t *fF,
+                         bool rightBorder, const batch_mask_t &active, batch_t *maxDelta);
+
+#pragma mark - Columns
+
+    /**
+     *  Kernels for `count` adjacent columns of a row-major block with `pitch` values per row.
+     *  Column `c` is the system for row `c` of the transposed block: its equation `i` is at `[i * pitch + c]`
+     *  (coefficients at `[(i * pitch + c) * kCoefficientsStride]`), so every step of a sweep loads
+     *  one contiguous run of each array. Borders are those of `fillFactors`, liquid rows are not used.
+     */
+    void fillColumns(double *rw, double *brw, size_t size, size_t count, size_t pitch,
+                     coefficient_t *aF, coefficient_t *bF, coefficient_t *cF, coefficient_t *fF,
+                     double *lm[3], double *rc[2], const RowConstants &k,
+                     bool leftBorder, bool rightBorder);
+
+    /**
+     *  @param c, f scratch of `count` values, eliminated coefficients of the previous cell are carried there in double
+     */
+    void firstPassColumns(size_t size, size_t count, size_t pitch,
+                          coefficient_t *aF, coefficient_t *bF, coefficient_t *cF, coefficient_t *fF, bool rightBorder,
+                          double *c, double *f);
+
+    /**
+     *  @param maxDelta per column max |new - previous|
+     *  @param d        scratch of `count` values for corrections of the previous cell
+     */
+    void secondPassColumns(double *rw, double *brw, size_t size, size_t count, size_t pitch,
+                           coefficient_t *bF, coefficient_t *cF, coefficient_t *fF,
+                           bool rightBorder, double *maxDelta, double *d);
+
+#pragma mark - Transpose
+
+    size_t const kTransposeTile = 32;
+
+    /**
+     *  Writes row-major `height` x `width` `src` into `dst` as `width` x `height`.
+     *  Rows of `src` are `srcPitch` values apart, rows of `dst` are `dstPitch` apart.
+     *  Goes by `kTransposeTile` square tiles, so that both arrays are walked in cache-sized pieces,
+     *  and with AVX by 4 x 4 blocks transposed in registers.
+     */
+    void transpose(const double *src, double *dst, size_t height, size_t width, size_t srcPitch, size_t dstPitch);
+
 }
 
 #endif /* algo_h */
@@ -0,0 +1,154 @@
+//
+//  Copyright © 2016 Nikolay Volosatov. All rights reserved.
+//
+
+#include "anderson.h"
+#include "algo.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+size_t const Anderson::kMaxDepth;
+
+Anderson::Anderson() {
+    depth = capacity = size = 0;
+    x = f = fPrev = gPrev = dF = dG = NULL;
+}
+
+Anderson::~Anderson() {
+    algo::arena().release(x);
+    algo::arena().release(f);
+    algo::arena().release(fPrev);
+    algo::arena().release(gPrev);
+    algo::arena().release(dF);
+    algo::arena().release(dG);
+}
+
+void Anderson::init(size_t depth, size_t capacity) {
+    this->depth = std::min(std::max(depth, (size_t)1), kMaxDepth);
+    this->capacity = capacity;
+
+    Arena &arena = algo::arena();
+    x = arena.allocDoubles(Arena::kMixing, capacity);
+    f = arena.allocDoubles(Arena::kMixing, capacity);
+    fPrev = arena.allocDoubles(Arena::kMixing, capacity);
+    gPrev = arena.allocDoubles(Arena::kMixing, capacity);
+    dF = arena.allocDoubles(Arena::kMixing, this->depth * capacity);
+    dG = arena.allocDoubles(Arena::kMixing, this->depth * capacity);
+}
+
+void Anderson::start(const double *x0, size_t size) {
+    this->size = size;
+    historySize = historyHead = 0;
+    lastResidual = 0;
+    hasPrev = false;
+    memcpy(x, x0, size * sizeof(double));
+}
+
+void Anderson::mix(double *g) {
+    double residual = 0;
+    for (size_t i = 0; i < size; ++i) {
+        f[i] = g[i] - x[i];
+        residual += f[i] * f[i];
+    }
+
+    if (hasPrev) {
+        double *dFh = dF + historyHead * capacity;
+        double *dGh = dG + historyHead * capacity;
+        for (size_t i = 0; i < size; ++i) {
+            dFh[i] = f[i] - fPrev[i];
+            dGh[i] = g[i] - gPrev[i];
+        }
+        historyHead = (historyHead + 1) % depth;
+        historySize = std::min(historySize + 1, depth);
+
+        if (residual > lastResidual) {
+            // Mixing diverges, restart from plain step
+            historySize = historyHead = 0;
+        }
+    }
+
+    memcpy(fPrev, f, size * sizeof(double));
+    memcpy(gPrev, g, size * sizeof(double));
+    lastResidual = residual;
+    hasPrev = true;
+
+    double gamma[kMaxDepth];
+    if (historySize > 0 && leastSquares(gamma)) {
+        for (size_t j = 0; j < historySize; ++j) {
+            double *dGj = dG + j * capacity;
+            for (size_t i = 0; i < size; ++i) {
+                g[i] -= gamma[j] * dGj[i];
+            }
+        }
+    }
+
+    memcpy(x, g, size * sizeof(double));
+}
+
+bool Anderson::leastSquares(double *gamma) {
+    // Normal equations (dF^T dF) gamma = dF^T f, solved with partial pivoting
+    size_t n = historySize;
+    double M[kMaxDepth][kMaxDepth + 1];
+
+    double maxDiag = 0;
+    for (size_t j = 0; j < n; ++j) {
+        double *dFj = dF + j * capacity;
+        for (size_t k = j; k < n; ++k) {
+            double *dFk = dF + k * capacity;
+            double sum = 0;
+            for (size_t i = 0; i < size; ++i) {
+                sum += dFj[i] * dFk[i];
+            }
+            M[j][k] = M[k][j] = sum;
+        }
+
+        double sum = 0;
+        for (size_t i = 0; i < size; ++i) {
+            sum += dFj[i] * f[i];
+        }
+        M[j][n] = sum;
+        maxDiag = std::max(maxDiag, M[j][j]);
+    }
+
+    if (maxDiag <= 0) {
+        return false;
+    }
+    for (size_t j = 0; j < n; ++j) {
+        M[j][j] += maxDiag * 1e-12;
+    }
+
+    for (size_t col = 0; col < n; ++col) {
+        size_t pivot = col;
+        for (size_t row = col + 1; row < n; ++row) {
+            if (fabs(M[row][col]) > fabs(M[pivot][col])) {
+                pivot = row;
+            }
+        }
+        if (fabs(M[pivot][col]) < maxDiag * 1e-14) {
+            return false;
+        }
+        if (pivot != col) {
+            for (size_t k = col; k <= n; ++k) {
+                std::swap(M[col][k], M[pivot][k]);
+            }
+        }
+
+        for (size_t row = col + 1; row < n; ++row) {
+            double m = M[row][col] / M[col][col];
+            for (size_t k = col; k <= n; ++k) {
+                M[row][k] -= m * M[col][k];
+            }
+        }
+    }
+
+    for (long j = n - 1; j >= 0; --j) {
+        double sum = M[j][n];
+        for (size_t k = j + 1; k < n; ++k) {
+            sum -= M[j][k] * gamma[k];
+        }
+        gamma[j] = sum / M[j][j];
+    }
+
+    return true;
+}
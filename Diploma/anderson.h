@@ -0,0 +1,47 @@
+//
+//  Copyright © 2016 Nikolay Volosatov. All rights reserved.
+//
+
+#ifndef anderson_h
+#define anderson_h
+
+#include <cstddef>
+
+/**
+ *  Anderson mixing for the fixed-point iterations x = G(x) of one row.
+ *
+ *  Keeps the last `depth` differences of residuals f = G(x) - x and of G(x)
+ *  and replaces G(x) with the combination that minimizes the residual.
+ *  History is dropped and a plain step is taken when the residual grows.
+ */
+class Anderson {
+    static size_t const kMaxDepth = 10;
+
+    size_t depth, capacity, size;
+    size_t historySize, historyHead;
+    double lastResidual;
+    bool hasPrev;
+
+    double *x, *f, *fPrev, *gPrev;
+    double *dF, *dG;
+
+    bool leastSquares(double *gamma);
+
+public:
+    Anderson();
+    ~Anderson();
+
+    void init(size_t depth, size_t capacity);
+
+    /**
+     *  Starts a new row from the initial iterate `x0`.
+     */
+    void start(const double *x0, size_t size);
+
+    /**
+     *  @param g G(x) of the current iterate on input, next iterate on output
+     */
+    void mix(double *g);
+};
+
+#endif /* anderson_h */
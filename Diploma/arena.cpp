@@ -0,0 +1,207 @@
+//
+//  Copyright © 2016 Nikolay Volosatov. All rights reserved.
+//
+
+#include "arena.h"
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+#include <algorithm>
+#include <vector>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+#ifdef __linux__
+// Memory policy constants of mbind(2), used without linking libnuma
+int const kPolicyPreferred = 1;
+#endif
+
+static size_t roundUp(size_t value, size_t step) {
+    return (value + step - 1) / step * step;
+}
+
+Arena::Arena() {
+    bytesInUse = peakBytes = 0;
+    std::fill(categoryBytes, categoryBytes + kCategoryCount, 0);
+    std::fill(categoryPeakBytes, categoryPeakBytes + kCategoryCount, 0);
+    bindNode = false;
+}
+
+const char *Arena::categoryName(Category category) {
+    static const char *names[kCategoryCount] = {
+        "layers", "coefficients", "rows", "batches", "predictor", "messages", "mixing", "other"
+    };
+    return names[category];
+}
+
+Arena::~Arena() {
+    while (blocks.empty() == false) {
+        release(blocks.begin()->first);
+    }
+}
+
+void *Arena::alloc(Category category, size_t bytes, bool hugePages) {
+    bytes = roundUp(std::max<size_t>(bytes, 1), kAlignment);
+
+    void *memory = NULL;
+    bool mapped = false;
+    if (hugePages && bytes >= kHugePageSize) {
+        bytes = roundUp(bytes, kHugePageSize);
+        memory = map(bytes, kHugePageSize);
+#ifdef MADV_HUGEPAGE
+        if (memory != NULL) {
+            madvise(memory, bytes, MADV_HUGEPAGE);
+        }
+#endif
+    } else if (bindNode && bytes >= kBindThreshold) {
+        bytes = roundUp(bytes, kPageSize);
+        memory = map(bytes, kPageSize);
+    }
+    mapped = memory != NULL;
+
+#ifdef __linux__
+    // Pages are not placed until touched, so the policy applies to all of them
+    int node = currentNode();
+    if (mapped && bindNode && node >= 0) {
+        std::vector<unsigned long> mask(node / (8 * sizeof(unsigned long)) + 1, 0);
+        mask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+        syscall(SYS_mbind, memory, bytes, kPolicyPreferred, mask.data(), mask.size() * 8 * sizeof(unsigned long) + 1, 0);
+    }
+#endif
+
+    if (memory == NULL && posix_memalign(&memory, kAlignment, bytes) != 0) {
+        throw std::bad_alloc();
+    }
+
+    Block block = {bytes, mapped, category};
+    blocks[memory] = block;
+    bytesInUse += bytes;
+    peakBytes = std::max(peakBytes, bytesInUse);
+    categoryBytes[category] += bytes;
+    categoryPeakBytes[category] = std::max(categoryPeakBytes[category], categoryBytes[category]);
+    return memory;
+}
+
+void *Arena::map(size_t bytes, size_t alignment) {
+    // Over-map and trim, so the block starts at an `alignment` boundary
+    size_t extra = alignment - kPageSize;
+    void *region = mmap(NULL, bytes + extra, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+        return NULL;
+    }
+    uintptr_t start = (uintptr_t)region;
+    uintptr_t aligned = roundUp(start, alignment);
+    if (aligned > start) {
+        munmap(region, aligned - start);
+    }
+    if (extra > aligned - start) {
+        munmap((void *)(aligned + bytes), extra - (aligned - start));
+    }
+    return (void *)aligned;
+}
+
+void Arena::release(void *memory) {
+    if (memory == NULL) {
+        return;
+    }
+    std::map<void *, Block>::iterator it = blocks.find(memory);
+    if (it == blocks.end()) {
+        return;
+    }
+    if (it->second.mapped) {
+        munmap(memory, it->second.bytes);
+    } else {
+        free(memory);
+    }
+    bytesInUse -= it->second.bytes;
+    categoryBytes[it->second.category] -= it->second.bytes;
+    blocks.erase(it);
+}
+
+double *Arena::allocDoubles(Category category, size_t count, bool hugePages) {
+    return (double *)alloc(category, count * sizeof(double), hugePages);
+}
+
+size_t Arena::rowStride(size_t width) {
+    size_t lineDoubles = kAlignment / sizeof(double);
+    size_t stride = roundUp(width, lineDoubles);
+    if ((stride * sizeof(double)) % kPageSize == 0) {
+        stride += lineDoubles;
+    }
+    return stride;
+}
+
+double *Arena::allocRows(Category category, size_t rows, size_t width) {
+    return allocDoubles(category, rows * rowStride(width));
+}
+
+size_t Arena::BytesInUse() const {
+    return bytesInUse;
+}
+
+size_t Arena::PeakBytes() const {
+    return peakBytes;
+}
+
+size_t Arena::BytesInUse(Category category) const {
+    return categoryBytes[category];
+}
+
+size_t Arena::PeakBytes(Category category) const {
+    return categoryPeakBytes[category];
+}
+
+#pragma mark - NUMA
+
+void Arena::setNodeBinding(bool bind) {
+    bindNode = bind;
+}
+
+int Arena::currentNode() {
+#ifdef __linux__
+    unsigned cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0) {
+        return (int)node;
+    }
+#endif
+    return -1;
+}
+
+bool Arena::pagePlacement(const void *memory, size_t bytes, size_t *local, size_t *placed) {
+    *local = *placed = 0;
+#ifdef __linux__
+    int node = currentNode();
+    if (memory == NULL || node < 0) {
+        return false;
+    }
+
+    // Whole pages of the block only, ends may be shared with other blocks
+    uintptr_t from = roundUp((uintptr_t)memory, kPageSize);
+    uintptr_t to = ((uintptr_t)memory + bytes) / kPageSize * kPageSize;
+    size_t const kChunk = 1024;
+    std::vector<void *> pages(kChunk);
+    std::vector<int> status(kChunk);
+    for (uintptr_t page = from; page < to; page += kChunk * kPageSize) {
+        size_t count = std::min<size_t>(kChunk, (to - page) / kPageSize);
+        for (size_t i = 0; i < count; ++i) {
+            pages[i] = (void *)(page + i * kPageSize);
+        }
+        // Without target nodes move_pages only reports the node of every page
+        if (syscall(SYS_move_pages, 0, count, pages.data(), NULL, status.data(), 0) != 0) {
+            return false;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (status[i] >= 0) {
+                ++*placed;
+                *local += status[i] == node;
+            }
+        }
+    }
+    return true;
+#else
+    return false;
+#endif
+}
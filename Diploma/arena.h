@@ -0,0 +1,101 @@
+//
+//  Copyright © 2016 Nikolay Volosatov. All rights reserved.
+//
+
+#ifndef arena_h
+#define arena_h
+
+#include <cstddef>
+#include <map>
+
+/**
+ *  Allocator of solver arrays. Blocks are aligned to a cache line, blocks of
+ *  a huge page or more are mapped separately and advised to use transparent huge pages.
+ *  With node binding large blocks prefer the NUMA node of the process.
+ *  Bytes handed out are counted per category of buffers, so memory use of a rank can be reported.
+ */
+class Arena {
+public:
+    enum Category {
+        kLayers,        // prev, curr and buff
+        kCoefficients,  // coefficients of rows and of the kept matrix
+        kRows,          // row sized buffers and property caches
+        kBatches,
+        kPredictor,     // history layers of the initial guess
+        kMessages,      // send and receive buffers
+        kMixing,        // Anderson history
+        kOther,         // weights, views
+        kCategoryCount
+    };
+
+    static const char *categoryName(Category category);
+
+private:
+    struct Block {
+        size_t bytes;
+        bool mapped;
+        Category category;
+    };
+
+    std::map<void *, Block> blocks;
+    size_t bytesInUse, peakBytes;
+    size_t categoryBytes[kCategoryCount], categoryPeakBytes[kCategoryCount];
+    bool bindNode;
+
+    void *map(size_t bytes, size_t alignment);
+
+public:
+    static size_t const kAlignment = 64;
+    static size_t const kHugePageSize = 2 << 20;
+    static size_t const kPageSize = 4096;
+
+    Arena();
+    ~Arena();
+
+    /**
+     *  @param category  kind of the buffer its bytes are counted in
+     *  @param hugePages map large blocks and advise them to the kernel as huge page backed
+     */
+    void *alloc(Category category, size_t bytes, bool hugePages = false);
+    void release(void *memory);
+
+    double *allocDoubles(Category category, size_t count, bool hugePages = false);
+
+    /**
+     *  Stride in doubles of rows of `width` values: whole cache lines, and not a multiple
+     *  of 4 KB, so the same cell of neighbouring rows does not map to the same cache set.
+     */
+    static size_t rowStride(size_t width);
+
+    /**
+     *  One block of `rows` rows at `rowStride(width)`.
+     */
+    double *allocRows(Category category, size_t rows, size_t width);
+
+    size_t BytesInUse() const;
+    size_t PeakBytes() const;
+    size_t BytesInUse(Category category) const;
+    size_t PeakBytes(Category category) const;
+
+#pragma mark - NUMA
+
+    /**
+     *  Blocks of `kBindThreshold` bytes or more allocated later prefer the node the process runs on.
+     */
+    void setNodeBinding(bool bind);
+
+    static size_t const kBindThreshold = 64 << 10;
+
+    /**
+     *  Node of the CPU the process runs on, or -1 when it is unknown.
+     */
+    static int currentNode();
+
+    /**
+     *  Counts touched pages of a block and those of them placed on the node of the process.
+     *  @return false when placement can not be queried on this system
+     */
+    static bool pagePlacement(const void *memory, size_t bytes, size_t *local, size_t *placed);
+};
+
+#endif /* arena_h */
@@ -10,7 +10,8 @@
 
 namespace balancing {
 
-    std::vector<double> sums;
+    // Prefix sums of the partition being computed, per thread
+    thread_local std::vector<double> sums;
 
     void formatSums(double *weights, size_t size) {
         sums.resize(size);
@@ -0,0 +1,205 @@
+//
+//  Copyright © 2016 Nikolay Volosatov. All rights reserved.
+//
+
+#include "comm.h"
+
+// Completed sends are looked for once there are this many of them
+static size_t const kMaxRequests = 64;
+
+static MPI_Op mpiOperation(Communicator::Operation operation) {
+    return operation == Communicator::kSum ? MPI_SUM : MPI_MAX;
+}
+
+MpiCommunicator::MpiCommunicator(MPI_Comm world) {
+    MPI_Comm_size(world, &size);
+
+    int dims[] = { size };
+    int wrap[] = { 0 };
+    MPI_Cart_create(world, 1, dims, wrap, 1, &comm);
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Cart_coords(comm, rank, 1, &coord);
+    MPI_Cart_shift(comm, 0, 1, &prev, &next);
+
+    for (size_t c = 0; c < kChannelCount; ++c) {
+        MPI_Comm_dup(comm, channels + c);
+    }
+
+    counts.assign(size, 1);
+    sendDispls.resize(size);
+    recvDispls.resize(size);
+    sendTypes.resize(size);
+    recvTypes.resize(size);
+}
+
+MpiCommunicator::~MpiCommunicator() {
+    waitSends();
+
+    std::map<TypeKey, MPI_Datatype> *types[] = {&vTypes, &hTypes};
+    for (size_t k = 0; k < 2; ++k) {
+        for (auto it = types[k]->begin(); it != types[k]->end(); ++it) {
+            MPI_Type_free(&it->second);
+        }
+    }
+
+    for (size_t c = 0; c < kChannelCount; ++c) {
+        MPI_Comm_free(channels + c);
+    }
+    MPI_Comm_free(&comm);
+}
+
+int MpiCommunicator::Rank() const {
+    return rank;
+}
+
+int MpiCommunicator::Size() const {
+    return size;
+}
+
+int MpiCommunicator::Coord() const {
+    return coord;
+}
+
+void MpiCommunicator::neighbours(int *prev, int *next) const {
+    *prev = this->prev;
+    *next = this->next;
+}
+
+MPI_Comm MpiCommunicator::channelComm(Channel channel) const {
+    return channels[channel];
+}
+
+#pragma mark - Messages
+
+void MpiCommunicator::send(const double *values, size_t count, int dest, int tag, Channel channel) {
+    if (requests.size() >= kMaxRequests) {
+        size_t kept = 0;
+        for (size_t i = 0; i < requests.size(); ++i) {
+            int done = 0;
+            MPI_Test(&requests[i], &done, MPI_STATUS_IGNORE);
+            if (done == false) {
+                requests[kept++] = requests[i];
+            }
+        }
+        requests.resize(kept);
+    }
+
+    MPI_Request request;
+    MPI_Isend(values, (int)count, MPI_DOUBLE, dest, tag, channels[channel], &request);
+    requests.push_back(request);
+}
+
+void MpiCommunicator::waitSends() {
+    MPI_Waitall((int)requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+    requests.clear();
+}
+
+bool MpiCommunicator::testSends() {
+    int done = 0;
+    MPI_Testall((int)requests.size(), requests.data(), &done, MPI_STATUSES_IGNORE);
+    if (done) {
+        requests.clear();
+    }
+    return done;
+}
+
+bool MpiCommunicator::probe(int source, int tag, Channel channel, bool wait, size_t *count) {
+    MPI_Status status;
+    int flag = 1;
+    if (wait) {
+        MPI_Probe(source, tag, channels[channel], &status);
+    } else {
+        MPI_Iprobe(source, tag, channels[channel], &flag, &status);
+    }
+    if (flag) {
+        int size;
+        MPI_Get_count(&status, MPI_DOUBLE, &size);
+        *count = size;
+    }
+    return flag;
+}
+
+void MpiCommunicator::idle() {
+    // Progress is made by the probes
+}
+
+void MpiCommunicator::recv(double *values, size_t count, int source, int tag, Channel channel) {
+    MPI_Recv(values, (int)count, MPI_DOUBLE, source, tag, channels[channel], MPI_STATUS_IGNORE);
+}
+
+#pragma mark - Collectives
+
+void MpiCommunicator::barrier() {
+    MPI_Barrier(comm);
+}
+
+void MpiCommunicator::reduce(const double *values, double *result, size_t count, Operation operation, int root) {
+    MPI_Reduce(values, result, (int)count, MPI_DOUBLE, mpiOperation(operation), root, comm);
+}
+
+void MpiCommunicator::reduce(const unsigned long long *values, unsigned long long *result, size_t count,
+                             Operation operation, int root) {
+    MPI_Reduce(values, result, (int)count, MPI_UNSIGNED_LONG_LONG, mpiOperation(operation), root, comm);
+}
+
+void MpiCommunicator::gather(const double *values, size_t count, double *result,
+                             const int *counts, const int *displs, int root) {
+    MPI_Gatherv(values, (int)count, MPI_DOUBLE, result, counts, displs, MPI_DOUBLE, root, comm);
+}
+
+void MpiCommunicator::broadcast(int *values, size_t count, int root) {
+    MPI_Bcast(values, (int)count, MPI_INT, root, comm);
+}
+
+#pragma mark - Transpose
+
+MPI_Datatype MpiCommunicator::vType(size_t pitch, size_t height, size_t bWidth) {
+    TypeKey key(pitch, height, bWidth);
+    auto it = vTypes.find(key);
+    if (it == vTypes.end()) {
+        // `bWidth` columns of `height` values, one after another
+        MPI_Datatype column, resized, type;
+        MPI_Type_vector((int)height, 1, (int)pitch, MPI_DOUBLE, &column);
+        MPI_Type_create_resized(column, 0, sizeof(double), &resized);
+        MPI_Type_free(&column);
+
+        MPI_Type_contiguous((int)bWidth, resized, &type);
+        MPI_Type_commit(&type);
+        MPI_Type_free(&resized);
+
+        it = vTypes.insert(std::make_pair(key, type)).first;
+    }
+    return it->second;
+}
+
+MPI_Datatype MpiCommunicator::hType(size_t pitch, size_t height, size_t bWidth) {
+    TypeKey key(pitch, height, bWidth);
+    auto it = hTypes.find(key);
+    if (it == hTypes.end()) {
+        // `height` rows of `bWidth` values
+        MPI_Datatype rows, type;
+        MPI_Type_vector((int)height, (int)bWidth, (int)pitch, MPI_DOUBLE, &rows);
+        MPI_Type_create_resized(rows, 0, (int)height * sizeof(double), &type);
+        MPI_Type_commit(&type);
+        MPI_Type_free(&rows);
+
+        it = hTypes.insert(std::make_pair(key, type)).first;
+    }
+    return it->second;
+}
+
+void MpiCommunicator::transpose(const double *src, double *dst, size_t pitch, const size_t *rows, const size_t *cols) {
+    size_t fromCol = 0, fromRow = 0;
+    for (int i = 0; i < size; ++i) {
+        sendDispls[i] = (int)(fromCol * sizeof(double));
+        recvDispls[i] = (int)(fromRow * sizeof(double));
+        sendTypes[i] = vType(pitch, rows[coord], cols[i]);
+        recvTypes[i] = hType(pitch, cols[coord], rows[i]);
+        fromCol += cols[i];
+        fromRow += rows[i];
+    }
+
+    MPI_Alltoallw(src, counts.data(), sendDispls.data(), sendTypes.data(),
+                  dst, counts.data(), recvDispls.data(), recvTypes.data(), comm);
+}
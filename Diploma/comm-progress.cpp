@@ -0,0 +1,274 @@
+//
+//  Copyright © 2016 Nikolay Volosatov. All rights reserved.
+//
+
+#include "comm.h"
+#include <algorithm>
+
+// Slots of every mailbox, and receives posted ahead into them
+static size_t const kInboxSlots = 256;
+static size_t const kPostedReceives = 8;
+
+ProgressCommunicator::ProgressCommunicator(MpiCommunicator *inner, size_t messageSize) {
+    this->inner = inner;
+    this->messageSize = messageSize;
+
+    for (int i = 0, count = inner->Size() * kChannelCount; i < count; ++i) {
+        inboxes.emplace_back(kInboxSlots);
+    }
+
+    // Pipeline messages come from the neighbours only
+    int sources[2];
+    inner->neighbours(sources, sources + 1);
+    Channel channels[] = {kFirstPass, kSecondPass};
+    for (size_t s = 0; s < 2; ++s) {
+        for (size_t c = 0; c < 2; ++c) {
+            if (sources[s] != MPI_PROC_NULL) {
+                Stream stream;
+                stream.source = sources[s];
+                stream.channel = channels[c];
+                streams.push_back(stream);
+            }
+        }
+    }
+
+    pendingSends.store(0);
+    stopping.store(false);
+    pauseRequested.store(false);
+    paused.store(false);
+    thread = std::thread(&ProgressCommunicator::loop, this);
+}
+
+ProgressCommunicator::~ProgressCommunicator() {
+    waitSends();
+    stopping.store(true);
+    thread.join();
+
+    // Receives nobody sent to are still posted
+    for (size_t s = 0; s < streams.size(); ++s) {
+        for (size_t i = 0; i < streams[s].requests.size(); ++i) {
+            MPI_Cancel(&streams[s].requests[i]);
+            MPI_Wait(&streams[s].requests[i], MPI_STATUS_IGNORE);
+        }
+    }
+}
+
+void ProgressCommunicator::loop() {
+    // Handed over messages are kept in their slots until `inner` has sent them
+    size_t sent = 0;
+
+    while (stopping.load(std::memory_order_acquire) == false) {
+        // Sends handed over before a collective are posted before it, as they would be without the thread
+        bool pausing = pauseRequested.load(std::memory_order_acquire);
+        bool busy = progressSends(sent);
+
+        if (pausing) {
+            paused.store(true, std::memory_order_release);
+            while (pauseRequested.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            paused.store(false, std::memory_order_release);
+            continue;
+        }
+
+        for (size_t s = 0; s < streams.size(); ++s) {
+            busy = progressStream(streams[s]) || busy;
+        }
+        busy = progressBalance() || busy;
+
+        if (busy == false) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool ProgressCommunicator::progressSends(size_t &sent) {
+    bool busy = false;
+    for (size_t size = outbox.size(); sent < size; ++sent) {
+        Outgoing &outgoing = outbox.at(sent);
+        inner->send(outgoing.values.data(), outgoing.values.size(), outgoing.dest, outgoing.tag, outgoing.channel);
+        busy = true;
+    }
+    if (sent > 0 && inner->testSends()) {
+        pendingSends.fetch_sub(sent, std::memory_order_release);
+        for (; sent > 0; --sent) {
+            outbox.pop();
+        }
+    }
+    return busy;
+}
+
+bool ProgressCommunicator::progressStream(Stream &stream) {
+    Mailbox &box = inboxes[stream.source * kChannelCount + stream.channel];
+    bool busy = false;
+
+    // Completed receives are at the front, their slots are the first after the last value
+    while (stream.requests.empty() == false) {
+        int done = 0;
+        MPI_Status status;
+        MPI_Test(&stream.requests.front(), &done, &status);
+        if (done == false) {
+            break;
+        }
+        int count;
+        MPI_Get_count(&status, MPI_DOUBLE, &count);
+        Message &message = box.ahead(0);
+        message.tag = status.MPI_TAG;
+        message.received = false;
+        message.values.resize(count);
+        box.push();
+        stream.requests.pop_front();
+        busy = true;
+    }
+
+    // Values of the slots are not touched by the consumer until they are pushed
+    MPI_Comm comm = inner->channelComm(stream.channel);
+    size_t room = box.room();
+    while (stream.requests.size() < std::min(kPostedReceives, room)) {
+        Message &message = box.ahead(stream.requests.size());
+        message.values.resize(messageSize);
+        MPI_Request request;
+        MPI_Irecv(message.values.data(), (int)messageSize, MPI_DOUBLE, stream.source, MPI_ANY_TAG, comm, &request);
+        stream.requests.push_back(request);
+    }
+    return busy;
+}
+
+bool ProgressCommunicator::progressBalance() {
+    bool busy = false;
+    MPI_Comm comm = inner->channelComm(kBalance);
+    while (true) {
+        MPI_Status status;
+        int flag = 0;
+        MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, comm, &flag, &status);
+        if (flag == false) {
+            return busy;
+        }
+
+        // A full mailbox is filled once its reader takes some messages
+        Mailbox &box = inboxes[status.MPI_SOURCE * kChannelCount + kBalance];
+        if (box.room() == 0) {
+            return busy;
+        }
+        int count;
+        MPI_Get_count(&status, MPI_DOUBLE, &count);
+        Message &message = box.ahead(0);
+        message.tag = status.MPI_TAG;
+        message.received = false;
+        message.values.resize(count);
+        MPI_Recv(message.values.data(), count, MPI_DOUBLE, status.MPI_SOURCE, status.MPI_TAG, comm, MPI_STATUS_IGNORE);
+        box.push();
+        busy = true;
+    }
+}
+
+void ProgressCommunicator::pause() {
+    pauseRequested.store(true, std::memory_order_release);
+    while (paused.load(std::memory_order_acquire) == false) {
+        std::this_thread::yield();
+    }
+}
+
+void ProgressCommunicator::resume() {
+    // The thread has to see the request gone before the next pause waits for it again
+    pauseRequested.store(false, std::memory_order_release);
+    while (paused.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+}
+
+int ProgressCommunicator::Rank() const {
+    return inner->Rank();
+}
+
+int ProgressCommunicator::Size() const {
+    return inner->Size();
+}
+
+int ProgressCommunicator::Coord() const {
+    return inner->Coord();
+}
+
+void ProgressCommunicator::neighbours(int *prev, int *next) const {
+    inner->neighbours(prev, next);
+}
+
+#pragma mark - Messages
+
+void ProgressCommunicator::send(const double *values, size_t count, int dest, int tag, Channel channel) {
+    Outgoing &outgoing = outbox.back();
+    outgoing.dest = dest;
+    outgoing.tag = tag;
+    outgoing.channel = channel;
+    outgoing.values.assign(values, values + count);
+    pendingSends.fetch_add(1, std::memory_order_relaxed);
+    outbox.push();
+}
+
+void ProgressCommunicator::waitSends() {
+    while (pendingSends.load(std::memory_order_acquire) > 0) {
+        std::this_thread::yield();
+    }
+}
+
+bool ProgressCommunicator::probe(int source, int tag, Channel channel, bool wait, size_t *count) {
+    Mailbox &box = inboxes[source * kChannelCount + channel];
+    Message *message;
+    while ((message = match(box, tag)) == NULL) {
+        if (wait == false) {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    *count = message->values.size();
+    return true;
+}
+
+void ProgressCommunicator::idle() {
+    // Messages come from the thread
+    std::this_thread::yield();
+}
+
+void ProgressCommunicator::recv(double *values, size_t count, int source, int tag, Channel channel) {
+    receive(inboxes[source * kChannelCount + channel], values, count, tag);
+}
+
+#pragma mark - Collectives
+
+void ProgressCommunicator::barrier() {
+    pause();
+    inner->barrier();
+    resume();
+}
+
+void ProgressCommunicator::reduce(const double *values, double *result, size_t count, Operation operation, int root) {
+    pause();
+    inner->reduce(values, result, count, operation, root);
+    resume();
+}
+
+void ProgressCommunicator::reduce(const unsigned long long *values, unsigned long long *result, size_t count,
+                                  Operation operation, int root) {
+    pause();
+    inner->reduce(values, result, count, operation, root);
+    resume();
+}
+
+void ProgressCommunicator::gather(const double *values, size_t count, double *result,
+                                  const int *counts, const int *displs, int root) {
+    pause();
+    inner->gather(values, count, result, counts, displs, root);
+    resume();
+}
+
+void ProgressCommunicator::broadcast(int *values, size_t count, int root) {
+    pause();
+    inner->broadcast(values, count, root);
+    resume();
+}
+
+void ProgressCommunicator::transpose(const double *src, double *dst, size_t pitch, const size_t *rows, const size_t *cols) {
+    pause();
+    inner->transpose(src, dst, pitch, rows, cols);
+    resume();
+}
@@ -0,0 +1,200 @@
+//
+//  Copyright © 2016 Nikolay Volosatov. All rights reserved.
+//
+
+#include "comm.h"
+#include "algo.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+SharedWorld::SharedWorld(size_t ranks) : mailboxes(ranks * ranks * Communicator::kChannelCount), published(ranks) {
+    this->ranks = ranks;
+    barrierCount.store(0);
+    barrierGeneration.store(0);
+}
+
+size_t SharedWorld::Ranks() const {
+    return ranks;
+}
+
+Communicator::Mailbox &SharedWorld::mailbox(int source, int dest, Communicator::Channel channel) {
+    return mailboxes[(source * ranks + dest) * Communicator::kChannelCount + channel];
+}
+
+void Communicator::post(Mailbox &box, int tag, const double *values, size_t count) {
+    Message &message = box.back();
+    message.tag = tag;
+    message.received = false;
+    message.values.assign(values, values + count);
+    box.push();
+}
+
+Communicator::Message *Communicator::match(Mailbox &box, int tag) {
+    for (size_t i = 0, size = box.size(); i < size; ++i) {
+        Message &message = box.at(i);
+        if (message.received == false && (tag == MPI_ANY_TAG || message.tag == tag)) {
+            return &message;
+        }
+    }
+    return NULL;
+}
+
+void Communicator::receive(Mailbox &box, double *values, size_t count, int tag) {
+    Message *message;
+    while ((message = match(box, tag)) == NULL) {
+        std::this_thread::yield();
+    }
+    std::copy(message->values.begin(), message->values.begin() + std::min(count, message->values.size()), values);
+    message->received = true;
+
+    while (box.size() > 0 && box.at(0).received) {
+        box.pop();
+    }
+}
+
+void SharedWorld::barrier() {
+    // The last rank to come resets the count before it lets the others go
+    size_t generation = barrierGeneration.load(std::memory_order_acquire);
+    if (barrierCount.fetch_add(1, std::memory_order_acq_rel) + 1 == ranks) {
+        barrierCount.store(0, std::memory_order_relaxed);
+        barrierGeneration.fetch_add(1, std::memory_order_release);
+    } else {
+        while (barrierGeneration.load(std::memory_order_acquire) == generation) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+SharedCommunicator::SharedCommunicator(SharedWorld &world, int rank) : world(world) {
+    this->rank = rank;
+}
+
+int SharedCommunicator::Rank() const {
+    return rank;
+}
+
+int SharedCommunicator::Size() const {
+    return (int)world.Ranks();
+}
+
+int SharedCommunicator::Coord() const {
+    return rank;
+}
+
+void SharedCommunicator::neighbours(int *prev, int *next) const {
+    *prev = rank > 0 ? rank - 1 : MPI_PROC_NULL;
+    *next = rank + 1 < Size() ? rank + 1 : MPI_PROC_NULL;
+}
+
+#pragma mark - Messages
+
+void SharedCommunicator::send(const double *values, size_t count, int dest, int tag, Channel channel) {
+    post(world.mailbox(rank, dest, channel), tag, values, count);
+}
+
+void SharedCommunicator::waitSends() {
+    // Values are copied by `send`
+}
+
+bool SharedCommunicator::probe(int source, int tag, Channel channel, bool wait, size_t *count) {
+    Mailbox &box = world.mailbox(source, rank, channel);
+    Message *message;
+    while ((message = match(box, tag)) == NULL) {
+        if (wait == false) {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    *count = message->values.size();
+    return true;
+}
+
+void SharedCommunicator::idle() {
+    std::this_thread::yield();
+}
+
+void SharedCommunicator::recv(double *values, size_t count, int source, int tag, Channel channel) {
+    receive(world.mailbox(source, rank, channel), values, count, tag);
+}
+
+#pragma mark - Collectives
+
+void SharedCommunicator::barrier() {
+    world.barrier();
+}
+
+template <typename T>
+static void reduceShared(SharedWorld &world, int rank, const T *values, T *result, size_t count,
+                         Communicator::Operation operation, int root) {
+    world.published[rank] = values;
+    world.barrier();
+
+    if (rank == root) {
+        // Ranks are folded in their order, so sums do not depend on timing
+        std::copy((const T *)world.published[0], (const T *)world.published[0] + count, result);
+        for (size_t r = 1; r < world.Ranks(); ++r) {
+            const T *other = (const T *)world.published[r];
+            for (size_t i = 0; i < count; ++i) {
+                result[i] = operation == Communicator::kSum ? result[i] + other[i] : std::max(result[i], other[i]);
+            }
+        }
+    }
+    world.barrier();
+}
+
+void SharedCommunicator::reduce(const double *values, double *result, size_t count, Operation operation, int root) {
+    reduceShared(world, rank, values, result, count, operation, root);
+}
+
+void SharedCommunicator::reduce(const unsigned long long *values, unsigned long long *result, size_t count,
+                                Operation operation, int root) {
+    reduceShared(world, rank, values, result, count, operation, root);
+}
+
+void SharedCommunicator::gather(const double *values, size_t count, double *result,
+                                const int *counts, const int *displs, int root) {
+    world.published[rank] = values;
+    world.barrier();
+
+    if (rank == root) {
+        for (size_t r = 0; r < world.Ranks(); ++r) {
+            // Values of the root may already be in place
+            size_t size = (int)r == rank ? count : counts[r];
+            memmove(result + displs[r], world.published[r], size * sizeof(double));
+        }
+    }
+    world.barrier();
+}
+
+void SharedCommunicator::broadcast(int *values, size_t count, int root) {
+    world.published[rank] = values;
+    world.barrier();
+
+    if (rank != root) {
+        const int *rootValues = (const int *)world.published[root];
+        std::copy(rootValues, rootValues + count, values);
+    }
+    world.barrier();
+}
+
+#pragma mark - Transpose
+
+void SharedCommunicator::transpose(const double *src, double *dst, size_t pitch, const size_t *rows, const size_t *cols) {
+    world.published[rank] = src;
+    world.barrier();
+
+    // Block of every rank goes from its rows straight into ours, no messages in between
+    size_t fromCol = 0;
+    for (int i = 0; i < rank; ++i) {
+        fromCol += cols[i];
+    }
+
+    size_t fromRow = 0;
+    for (size_t r = 0; r < world.Ranks(); ++r) {
+        const double *block = (const double *)world.published[r] + fromCol;
+        algo::transpose(block, dst + fromRow, rows[r], cols[rank], pitch, pitch);
+        fromRow += rows[r];
+    }
+    world.barrier();
+}
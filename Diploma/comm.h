@@ -0,0 +1,414 @@
+//
+//  Copyright © 2016 Nikolay Volosatov. All rights reserved.
+//
+
+#ifndef comm_h
+#define comm_h
+
+#include <cstddef>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <tuple>
+#include <vector>
+#include <mpi.h>
+#include <thread>
+
+/**
+ *  Bounded queue with one producer and one consumer thread, without locks. Values are filled and
+ *  read in their slots, which are reused with their buffers, so steady traffic does not allocate.
+ *  Slots are allocated by the first push, queues nobody writes to cost nothing.
+ *  A full queue makes the producer wait for the consumer.
+ */
+template <typename T>
+class SpscQueue {
+    size_t capacity;
+    std::vector<T> slots;
+
+    // Ends are written by different threads, so they are on separate cache lines.
+    // Padded rather than aligned, queues are kept in vectors, which do not over-align
+    std::atomic<size_t> head;
+    char padding[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> tail;
+
+public:
+    explicit SpscQueue(size_t capacity = 4096) {
+        this->capacity = capacity;
+        head.store(0);
+        tail.store(0);
+    }
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    /**
+     *  Slot after the last value, it is seen by the consumer after `push`.
+     */
+    T &back() {
+        while (room() == 0) {
+            std::this_thread::yield();
+        }
+        return ahead(0);
+    }
+
+    /**
+     *  Free slots, as seen by the producer.
+     */
+    size_t room() const {
+        return capacity - (tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire));
+    }
+
+    /**
+     *  Free slot `index` after the last value, `index < room()`. The producer may fill slots ahead
+     *  and push them in order.
+     */
+    T &ahead(size_t index) {
+        if (slots.empty()) {
+            slots.resize(capacity);
+        }
+        return slots[(tail.load(std::memory_order_relaxed) + index) % capacity];
+    }
+
+    void push() {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    size_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_relaxed);
+    }
+
+    /**
+     *  Value `index` after the first one, `index < size()`.
+     */
+    T &at(size_t index) {
+        return slots[(head.load(std::memory_order_relaxed) + index) % capacity];
+    }
+
+    /**
+     *  Gives the slot of the first value back to the producer.
+     */
+    void pop() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+};
+
+/**
+ *  Data exchange of the fields. Ranks form a chain by their coordinates, ends of the chain
+ *  have `MPI_PROC_NULL` neighbours with every backend.
+ *  Messages go by channel, so traffic of the two passes and of balancing never mixes.
+ *  Collectives are called by every rank, results of reductions and gathers are at `root` only.
+ */
+class Communicator {
+public:
+    enum Channel {
+        kFirstPass,
+        kSecondPass,
+        kBalance,
+        kChannelCount
+    };
+
+    enum Operation {
+        kSum,
+        kMax
+    };
+
+    struct Message {
+        int tag;
+        bool received;
+        std::vector<double> values;
+    };
+
+    /**
+     *  Messages from one rank on one channel. The receiver reads them in place; those received
+     *  out of order are marked and leave the queue with the ones before them.
+     */
+    typedef SpscQueue<Message> Mailbox;
+
+    virtual ~Communicator() {}
+
+    virtual int Rank() const = 0;
+    virtual int Size() const = 0;
+    virtual int Coord() const = 0;
+
+    /**
+     *  Ranks of coordinates `Coord() - 1` and `Coord() + 1`.
+     */
+    virtual void neighbours(int *prev, int *next) const = 0;
+
+#pragma mark - Messages
+
+    /**
+     *  Starts sending `count` values. They may be read until `waitSends`, or until the receiver got them.
+     */
+    virtual void send(const double *values, size_t count, int dest, int tag, Channel channel) = 0;
+    virtual void waitSends() = 0;
+
+    /**
+     *  @param wait  block until the message is there
+     *  @param count size of the message, when there is one
+     *  @return false when the message of `tag` has not come yet
+     */
+    virtual bool probe(int source, int tag, Channel channel, bool wait, size_t *count) = 0;
+
+    /**
+     *  Called between probes while waiting for any of several messages. Ranks sharing cores
+     *  give way to the others; MPI keeps polling, as its own blocking probe does.
+     */
+    virtual void idle() = 0;
+
+    /**
+     *  Receives the message of `tag`, `values` have room for `count` of them.
+     */
+    virtual void recv(double *values, size_t count, int source, int tag, Channel channel) = 0;
+
+#pragma mark - Collectives
+
+    virtual void barrier() = 0;
+
+    virtual void reduce(const double *values, double *result, size_t count, Operation operation, int root) = 0;
+    virtual void reduce(const unsigned long long *values, unsigned long long *result, size_t count,
+                        Operation operation, int root) = 0;
+
+    /**
+     *  Values of rank `i` go to `result + displs[i]`, there are `counts[i]` of them.
+     */
+    virtual void gather(const double *values, size_t count, double *result,
+                        const int *counts, const int *displs, int root) = 0;
+
+    virtual void broadcast(int *values, size_t count, int root) = 0;
+
+    /**
+     *  Transposes a square field split by rows: `src` has `rows[Coord()]` rows of this rank,
+     *  `dst` gets `cols[Coord()]` rows of the transposed field. Row `k` of `dst` is column
+     *  `cols[0] + ... + cols[Coord() - 1] + k` of the field. Rows of both arrays are `pitch` values apart.
+     *  Arrays must not overlap.
+     */
+    virtual void transpose(const double *src, double *dst, size_t pitch, const size_t *rows, const size_t *cols) = 0;
+
+protected:
+    /**
+     *  Copies `count` values into the next slot of `box`, its buffer is reused.
+     */
+    static void post(Mailbox &box, int tag, const double *values, size_t count);
+
+    /**
+     *  @param tag `MPI_ANY_TAG` matches every message
+     *  @return the first message of `tag` not received yet, NULL when there is none
+     */
+    static Message *match(Mailbox &box, int tag);
+
+    /**
+     *  Waits for the message of `tag` in `box` and receives it.
+     */
+    static void receive(Mailbox &box, double *values, size_t count, int tag);
+};
+
+#pragma mark - MPI
+
+/**
+ *  Ranks are processes of an MPI communicator. Channels are duplicates of its cartesian communicator.
+ */
+class MpiCommunicator : public Communicator {
+    MPI_Comm comm;
+    MPI_Comm channels[kChannelCount];
+    int rank, size, coord, prev, next;
+
+    /**
+     *  Sends not completed yet. Completed ones are dropped when there are many of them.
+     */
+    std::vector<MPI_Request> requests;
+
+    /**
+     *  Block types by (pitch, height, bWidth). Bucket sizes recur, so types are built once.
+     */
+    typedef std::tuple<size_t, size_t, size_t> TypeKey;
+    std::map<TypeKey, MPI_Datatype> vTypes, hTypes;
+
+    MPI_Datatype vType(size_t pitch, size_t height, size_t bWidth);
+    MPI_Datatype hType(size_t pitch, size_t height, size_t bWidth);
+
+    std::vector<int> counts, sendDispls, recvDispls;
+    std::vector<MPI_Datatype> sendTypes, recvTypes;
+
+public:
+    explicit MpiCommunicator(MPI_Comm world);
+    ~MpiCommunicator();
+
+    /**
+     *  Communicator the messages of `channel` go by.
+     */
+    MPI_Comm channelComm(Channel channel) const;
+
+    /**
+     *  @return true when every send has completed, without waiting for them
+     */
+    bool testSends();
+
+    int Rank() const override;
+    int Size() const override;
+    int Coord() const override;
+    void neighbours(int *prev, int *next) const override;
+
+    void send(const double *values, size_t count, int dest, int tag, Channel channel) override;
+    void waitSends() override;
+    bool probe(int source, int tag, Channel channel, bool wait, size_t *count) override;
+    void idle() override;
+    void recv(double *values, size_t count, int source, int tag, Channel channel) override;
+
+    void barrier() override;
+    void reduce(const double *values, double *result, size_t count, Operation operation, int root) override;
+    void reduce(const unsigned long long *values, unsigned long long *result, size_t count,
+                Operation operation, int root) override;
+    void gather(const double *values, size_t count, double *result,
+                const int *counts, const int *displs, int root) override;
+    void broadcast(int *values, size_t count, int root) override;
+    void transpose(const double *src, double *dst, size_t pitch, const size_t *rows, const size_t *cols) override;
+};
+
+#pragma mark - Shared memory
+
+/**
+ *  Ranks of one process: mailboxes between every pair of them and the buffers of the current collective.
+ */
+class SharedWorld {
+    size_t ranks;
+    std::vector<Communicator::Mailbox> mailboxes;
+
+    std::atomic<size_t> barrierCount, barrierGeneration;
+
+public:
+    explicit SharedWorld(size_t ranks);
+
+    size_t Ranks() const;
+    Communicator::Mailbox &mailbox(int source, int dest, Communicator::Channel channel);
+
+    /**
+     *  Buffers of every rank for the collective in progress. Written before a barrier, read after it.
+     */
+    std::vector<const void *> published;
+
+    void barrier();
+};
+
+/**
+ *  Rank of a `SharedWorld`, run by a thread of the process. Messages are copied once, into the
+ *  mailbox; transposes and collectives read the buffers of other ranks in place.
+ */
+class SharedCommunicator : public Communicator {
+    SharedWorld &world;
+    int rank;
+
+public:
+    SharedCommunicator(SharedWorld &world, int rank);
+
+    int Rank() const override;
+    int Size() const override;
+    int Coord() const override;
+    void neighbours(int *prev, int *next) const override;
+
+    void send(const double *values, size_t count, int dest, int tag, Channel channel) override;
+    void waitSends() override;
+    bool probe(int source, int tag, Channel channel, bool wait, size_t *count) override;
+    void idle() override;
+    void recv(double *values, size_t count, int source, int tag, Channel channel) override;
+
+    void barrier() override;
+    void reduce(const double *values, double *result, size_t count, Operation operation, int root) override;
+    void reduce(const unsigned long long *values, unsigned long long *result, size_t count,
+                Operation operation, int root) override;
+    void gather(const double *values, size_t count, double *result,
+                const int *counts, const int *displs, int root) override;
+    void broadcast(int *values, size_t count, int root) override;
+    void transpose(const double *src, double *dst, size_t pitch, const size_t *rows, const size_t *cols) override;
+};
+
+#pragma mark - Progress
+
+/**
+ *  Messages of `inner` are sent and received by a thread of its own, so the caller never calls MPI
+ *  to make progress. Sends are handed over through a queue. Receives of the pipeline channels are
+ *  posted ahead from both neighbours, straight into free slots of their mailboxes, which are pushed
+ *  in the order the receives complete. Balance messages are probed for, they are rare and larger.
+ *  Collectives pause the thread and go to `inner` from the caller, one thread at a time,
+ *  so MPI needs `MPI_THREAD_SERIALIZED`.
+ */
+class ProgressCommunicator : public Communicator {
+    MpiCommunicator *inner;
+    size_t messageSize;
+
+    struct Outgoing {
+        int dest, tag;
+        Channel channel;
+        std::vector<double> values;
+    };
+
+    /**
+     *  Slots of sends handed over to `inner` stay in the queue until they complete.
+     */
+    SpscQueue<Outgoing> outbox;
+
+    /**
+     *  Mailboxes by source and channel. Slots of pipeline mailboxes hold `messageSize` values each,
+     *  so they are fewer than those of thread ranks.
+     */
+    std::deque<Mailbox> inboxes;
+
+    /**
+     *  Receives posted into the slots of one mailbox, oldest first. Messages of one source
+     *  and channel match receives in the order they were posted.
+     */
+    struct Stream {
+        int source;
+        Channel channel;
+        std::deque<MPI_Request> requests;
+    };
+    std::vector<Stream> streams;
+
+    /**
+     *  Sends handed over and not completed yet.
+     */
+    std::atomic<size_t> pendingSends;
+
+    std::atomic<bool> stopping, pauseRequested, paused;
+    std::thread thread;
+
+    void loop();
+    bool progressSends(size_t &sent);
+    bool progressStream(Stream &stream);
+    bool progressBalance();
+
+    /**
+     *  Collectives are called between `pause` and `resume`.
+     */
+    void pause();
+    void resume();
+
+public:
+    /**
+     *  @param messageSize values of the largest pipeline message
+     */
+    ProgressCommunicator(MpiCommunicator *inner, size_t messageSize);
+    ~ProgressCommunicator();
+
+    int Rank() const override;
+    int Size() const override;
+    int Coord() const override;
+    void neighbours(int *prev, int *next) const override;
+
+    void send(const double *values, size_t count, int dest, int tag, Channel channel) override;
+    void waitSends() override;
+    bool probe(int source, int tag, Channel channel, bool wait, size_t *count) override;
+    void idle() override;
+    void recv(double *values, size_t count, int source, int tag, Channel channel) override;
+
+    void barrier() override;
+    void reduce(const double *values, double *result, size_t count, Operation operation, int root) override;
+    void reduce(const unsigned long long *values, unsigned long long *result, size_t count,
+                Operation operation, int root) override;
+    void gather(const double *values, size_t count, double *result,
+                const int *counts, const int *displs, int root) override;
+    void broadcast(int *values, size_t count, int root) override;
+    void transpose(const double *src, double *dst, size_t pitch, const size_t *rows, const size_t *cols) override;
+};
+
+#endif /* comm_h */
@@ -26,6 +26,14 @@ double Config::value(std::string name) const {
     return atof(values.at(name).data());
 }
 
+double Config::value(std::string name, double defaultValue) const {
+    auto it = values.find(name);
+    if (it == values.end()) {
+        return defaultValue;
+    }
+    return atof(it->second.data());
+}
+
 std::string Config::str_value(std::string name) const {
     return values.at(name);
 }
@@ -14,6 +14,7 @@ public:
 
     Config(const char *filename);
     double value(std::string name) const;
+    double value(std::string name, double defaultValue) const;
     std::string str_value(std::string name) const;
 };
 
@@ -4,10 +4,19 @@
 
 #include "factors.h"
 #include <cmath>
+#include <cstdio>
+#include <cstring>
 
 size_t const kAlgorithmTranspose = 0;
 size_t const kAlgorithmStatic = 1;
 
+size_t const kBackendMpi = 0;
+size_t const kBackendThreads = 1;
+
+size_t const kNonlinearPicard = 0;
+size_t const kNonlinearNewton = 1;
+size_t const kNonlinearAnderson = 2;
+
 namespace ftr {
     static double const moveVelocity = 0.75 / 60; // м/с
 
@@ -61,18 +70,20 @@ namespace ftr {
 
     static double const Ti[] = { 1000, 1033, 923, 1033 };
     static double const dTi[] = { 70, 350, 1100, 170 };
-    static double Li[] = {
+    static double const Li[] = {
         4.5141 * (44076  - 85622  * x * x + 50357  * x) / dTi[0],
         4.5141 * (5163.2 - 74009  * x * x + 70232  * x) / dTi[1],
         4.5141 * (2622.3 - 92590  * x * x + 80523  * x) / dTi[2],
         4.5141 * (14775  + 154544 * x * x - 142489 * x) / dTi[3]
     };
 
-    inline double pow_2(double x) {
+    template<typename V>
+    inline V pow_2(V x) {
         return x * x;
     }
 
-    inline double fast_exp(double x) {
+    template<typename V>
+    inline V fast_exp(V x) {
         x = 1.0 + x / 4096.0;
         x *= x; x *= x; x *= x; x *= x;
         x *= x; x *= x; x *= x; x *= x;
@@ -80,7 +91,8 @@ namespace ftr {
         return x;
     }
 
-    inline double cSol(double T) {
+    template<typename V>
+    inline V cSol(V T) {
         return 469 + 0.16 * (T - 323)
             + Li[0] * fast_exp(-16 * pow_2((Ti[0] - T) / dTi[0]))
             + Li[1] * fast_exp(-16 * pow_2((Ti[1] - T) / dTi[1]))
@@ -88,9 +100,38 @@ namespace ftr {
             + Li[3] * fast_exp(-16 * pow_2((Ti[3] - T) / dTi[3]));
     }
 
-    inline double ksiFunc(double T) { // k = 0.7
+    template<typename V>
+    inline V ksiFunc(V T) { // k = 0.7
         return (1.31914e9 - (1.51221e6 + 444.52 * T) * T) / pow_2(1.8691e6 - (2843.51 + T) * T);
     }
+
+    /**
+     *  cEf for all lanes: every phase is computed and the result is blended by masks.
+     */
+    inline batch_t cEfBatch(batch_t T) {
+        batch_t liquid = {};
+        liquid += cLik;
+        batch_t solid = cSol(T);
+        batch_t mushy = solid + L * ksiFunc(T);
+
+        return batchSelect(T >= TLik, liquid, batchSelect(T > TSol, mushy, solid));
+    }
+
+    /**
+     *  cEf of the phase at `phaseT` evaluated at `T`.
+     *  Gives one-sided limits at TSol and TLik for the properties table.
+     */
+    inline double cEfOfPhase(double T, double phaseT) {
+        if (phaseT >= TLik) {
+            return cLik;
+        }
+        else if (phaseT > TSol) {
+            return cSol(T) + L * ksiFunc(T);
+        }
+        else {
+            return cSol(T);
+        }
+    }
 }
 
 void Factors::initFactors(Config config) {
@@ -111,14 +152,37 @@ void Factors::initFactors(Config config) {
     _transposeIterations = config.value("TransposeBalanceIterationsInterval");
     _transposeBalancingTimeFactor = config.value("TransposeBalanceTimeFactor");
     _staticBalancingThresholdFactor = config.value("StaticBalanceThresholdFactor");
+    _balanceHeadroom = std::max(config.value("BalanceHeadroom", 1.5), 1.0);
     _enableBalanceWeightsSmooth = config.value("EnableBalanceWeightsSmooth");
+    _enableHugePages = config.value("EnableHugePages", 0) > 0;
+    _enableNumaBinding = config.value("EnableNumaBinding", 0) > 0;
 
     _algorithm = config.value("Algorithm");
+    _enableBatchedRows = config.value("EnableBatchedRows", 0) > 0;
+    _enableFusedRows = config.value("EnableFusedRows", 0) > 0;
+    _enableLiquidRows = config.value("EnableLiquidRows", 0) > 0;
+    _enableColumnSweeps = config.value("EnableColumnSweeps", 0) > 0;
+    _nonlinearSolver = config.value("NonlinearSolver", kNonlinearPicard);
+    _andersonDepth = config.value("AndersonDepth", 3);
+    _predictorOrder = std::min<size_t>(config.value("PredictorOrder", 0), 2);
+    _enablePredictorBaseline = config.value("EnablePredictorBaseline", 0) > 0;
+    _threads = std::max<size_t>(config.value("Threads", 1), 1);
+    _backend = config.value("Backend", kBackendMpi);
+    _ranks = std::max<size_t>(config.value("Ranks", 1), 1);
+    _enableProgressThread = config.value("EnableProgressThread", 0) > 0;
 
     _TStart = config.value("InitT");
     _TEnv = config.value("EnvT");
     _TEnv4 = _TEnv * _TEnv * _TEnv * _TEnv;
 
+    _propertiesTableError = 0;
+    if (config.value("EnablePropertiesTable", 0) > 0) {
+        initPropertiesTable(config.value("PropertiesTableStep", 0.25), config.value("PropertiesTableTolerance", 1e-4));
+    }
+
+    _enablePropertiesCache = config.value("EnablePropertiesCache", 0) > 0;
+    _propertiesCacheTolerance = config.value("PropertiesCacheFactor", 1) * _epsilon;
+
     _enableConsole = config.value("EnableConsole") > 0;
     _enablePlot = config.value("EnablePlot") > 0;
     _enableMatrix = config.value("EnableMatrix") > 0;
@@ -154,16 +218,60 @@ void Factors::initFactors(const char *filename) {
     initFactors(*_config);
 }
 
-double Factors::cEf(double T) const {
-    if (T >= ftr::TLik) {
-        return ftr::cLik;
-    }
-    else if (T > ftr::TSol) {
-        return ftr::cSol(T) + ftr::L * ftr::ksiFunc(T);
+double Factors::buildPropertiesTable(double step) {
+    // TSol and TLik are both nodes of the grid
+    size_t mushySteps = (size_t)ceil((ftr::TLik - ftr::TSol) / step);
+    step = (ftr::TLik - ftr::TSol) / mushySteps;
+
+    // Analytic tables are defined on [Temps[0], Temps[last]] only, outside it table extrapolates
+    double TLow = ftr::Temps[0];
+    double THigh = ftr::Temps[sizeof(ftr::Temps) / sizeof(ftr::Temps[0]) - 1];
+
+    _propertiesTableT0 = ftr::TSol - floor((ftr::TSol - TLow) / step) * step;
+    _propertiesTableInvStep = 1.0 / step;
+
+    size_t count = (size_t)floor((THigh - _propertiesTableT0) / step);
+    _propertiesTableMaxIndex = count - 1;
+    _propertiesTable.resize(count);
+
+    double maxError = 0;
+    for (size_t index = 0; index < count; ++index) {
+        double T0 = _propertiesTableT0 + index * step;
+        double T1 = T0 + step;
+        double phaseT = T0 + step / 2;
+
+        PropertiesNode &node = _propertiesTable[index];
+        node.lambda = ftr::Lambda(T0);
+        node.lambdaSlope = ftr::Lambda(T1) - node.lambda;
+        node.roC = ftr::Ro(T0) * ftr::cEfOfPhase(T0, phaseT);
+        node.roCSlope = ftr::Ro(T1) * ftr::cEfOfPhase(T1, phaseT) - node.roC;
+
+        for (size_t k = 1; k < 4; ++k) {
+            double T = T0 + step * k / 4;
+            maxError = std::max(maxError, fabs(lambda(T) / analyticLambda(T) - 1));
+            maxError = std::max(maxError, fabs(roC(T) / analyticRoC(T) - 1));
+        }
     }
-    else {
-        return ftr::cSol(T);
+
+    return maxError;
+}
+
+void Factors::initPropertiesTable(double step, double tolerance) {
+    // Refine until table matches analytic properties
+    for (size_t attempt = 0; attempt < 8; ++attempt, step /= 2) {
+        _propertiesTableError = buildPropertiesTable(step);
+        if (_propertiesTableError <= tolerance) {
+            return;
+        }
     }
+
+    fprintf(stderr, "Properties table error %g is above %g, using analytic properties\n",
+            _propertiesTableError, tolerance);
+    _propertiesTable.clear();
+}
+
+double Factors::cEf(double T) const {
+    return ftr::cEfOfPhase(T, T);
 }
 
 double Factors::alpha(double t) const {
@@ -200,7 +308,7 @@ double Factors::sigma(double t) const {
     }
 }
 
-double Factors::lambda(double T) const {
+double Factors::analyticLambda(double T) const {
     return ftr::Lambda(T);
 }
 
@@ -208,6 +316,121 @@ double Factors::ro(double T) const {
     return ftr::Ro(T);
 }
 
+double Factors::analyticRoC(double T) const {
+    return ftr::Ro(T) * cEf(T);
+}
+
+double Factors::TLiquidus() const {
+    return ftr::TLik;
+}
+
+double Factors::liquidLambda() const {
+    return ftr::Lambda(ftr::TLik);
+}
+
+double Factors::liquidRoC() const {
+    return ftr::Ro(ftr::TLik) * ftr::cLik;
+}
+
+void Factors::evaluate(const double *T, size_t n, double *lambda, double *roC) const {
+    if (_propertiesTable.empty() == false) {
+        for (size_t i = 0; i < n; ++i) {
+            double offset;
+            const PropertiesNode &node = propertiesNode(T[i], offset);
+            lambda[i] = node.lambda + offset * node.lambdaSlope;
+            roC[i] = node.roC + offset * node.roCSlope;
+        }
+        return;
+    }
+
+    size_t i = 0;
+    for (; i + BATCH_LANES <= n; i += BATCH_LANES) {
+        batch_t t, lm, ro;
+        memcpy(&t, T + i, sizeof(t));
+
+        // Piecewise linear tables are gathered per lane
+        for (size_t lane = 0; lane < BATCH_LANES; ++lane) {
+            size_t index = 0;
+            double alpha = ftr::alphaForT(t[lane], index);
+            lm[lane] = ftr::Lambds[index - 1] + alpha * (ftr::Lambds[index] - ftr::Lambds[index - 1]);
+            ro[lane] = ftr::Ros[index - 1] + alpha * (ftr::Ros[index] - ftr::Ros[index - 1]);
+        }
+
+        batch_t rc = ro * ftr::cEfBatch(t);
+        memcpy(lambda + i, &lm, sizeof(lm));
+        memcpy(roC + i, &rc, sizeof(rc));
+    }
+
+    for (; i < n; ++i) {
+        lambda[i] = analyticLambda(T[i]);
+        roC[i] = analyticRoC(T[i]);
+    }
+}
+
+void Factors::evaluateDerivatives(const double *T, size_t n, double *lambda, double *roC,
+                                  double *dLambda, double *dRoC) const {
+    if (_propertiesTable.empty() == false) {
+        for (size_t i = 0; i < n; ++i) {
+            double offset;
+            const PropertiesNode &node = propertiesNode(T[i], offset);
+            lambda[i] = node.lambda + offset * node.lambdaSlope;
+            roC[i] = node.roC + offset * node.roCSlope;
+            dLambda[i] = node.lambdaSlope * _propertiesTableInvStep;
+            dRoC[i] = node.roCSlope * _propertiesTableInvStep;
+        }
+        return;
+    }
+
+    evaluate(T, n, lambda, roC);
+
+    double const dT = 0.01;
+    for (size_t i = 0; i < n; ++i) {
+        double TL = T[i] - dT, TR = T[i] + dT;
+        dLambda[i] = (ftr::Lambda(TR) - ftr::Lambda(TL)) / (2 * dT);
+        dRoC[i] = (ftr::Ro(TR) * ftr::cEfOfPhase(TR, T[i]) - ftr::Ro(TL) * ftr::cEfOfPhase(TL, T[i])) / (2 * dT);
+    }
+}
+
+void Factors::evaluateChanged(const double *T, size_t n, double *Tc, double *lambda, double *roC,
+                              double tolerance) const {
+    // Cells are refreshed by whole batches, so the vector path of `evaluate` is kept
+    for (size_t i = 0; i < n; i += BATCH_LANES) {
+        size_t len = std::min<size_t>(BATCH_LANES, n - i);
+
+        bool changed = false;
+        for (size_t j = i; j < i + len && changed == false; ++j) {
+            double t = T[j], tc = Tc[j];
+            bool samePhase = (t >= ftr::TLik) == (tc >= ftr::TLik) && (t > ftr::TSol) == (tc > ftr::TSol);
+            changed = (fabs(t - tc) <= tolerance && samePhase) == false;
+        }
+
+        if (changed) {
+            evaluate(T + i, len, lambda + i, roC + i);
+            memcpy(Tc + i, T + i, len * sizeof(double));
+        }
+    }
+}
+
+bool Factors::EnablePropertiesCache() const {
+    return _enablePropertiesCache;
+}
+
+double Factors::PropertiesCacheTolerance() const {
+    return _propertiesCacheTolerance;
+}
+
+bool Factors::EnablePropertiesTable() const {
+    return _propertiesTable.empty() == false;
+}
+
+double Factors::PropertiesTableStep() const {
+    return 1.0 / _propertiesTableInvStep;
+}
+
+double Factors::PropertiesTableError() const {
+    return _propertiesTableError;
+}
+
 double Factors::X1() const {
     return _x1;
 }
@@ -272,14 +495,74 @@ double Factors::StaticBalanceThresholdFactor() const {
     return _staticBalancingThresholdFactor;
 }
 
+double Factors::BalanceHeadroom() const {
+    return _balanceHeadroom;
+}
+
 bool Factors::EnableBalanceWeightsSmooth() const {
     return _enableBalanceWeightsSmooth;
 }
 
+bool Factors::EnableHugePages() const {
+    return _enableHugePages;
+}
+
+bool Factors::EnableNumaBinding() const {
+    return _enableNumaBinding;
+}
+
 size_t Factors::Algorithm() const {
     return _algorithm;
 }
 
+bool Factors::EnableBatchedRows() const {
+    return _enableBatchedRows;
+}
+
+bool Factors::EnableFusedRows() const {
+    return _enableFusedRows;
+}
+
+bool Factors::EnableLiquidRows() const {
+    return _enableLiquidRows;
+}
+
+bool Factors::EnableColumnSweeps() const {
+    return _enableColumnSweeps;
+}
+
+size_t Factors::NonlinearSolver() const {
+    return _nonlinearSolver;
+}
+
+size_t Factors::AndersonDepth() const {
+    return _andersonDepth;
+}
+
+size_t Factors::PredictorOrder() const {
+    return _predictorOrder;
+}
+
+bool Factors::EnablePredictorBaseline() const {
+    return _enablePredictorBaseline;
+}
+
+size_t Factors::Threads() const {
+    return _threads;
+}
+
+size_t Factors::Backend() const {
+    return _backend;
+}
+
+size_t Factors::Ranks() const {
+    return _ranks;
+}
+
+bool Factors::EnableProgressThread() const {
+    return _enableProgressThread;
+}
+
 double Factors::TStart() const {
     return _TStart;
 }
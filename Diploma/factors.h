@@ -7,24 +7,69 @@
 
 #include "config.h"
 #include <vector>
+#include <algorithm>
+
+#if defined(__AVX512F__)
+#define BATCH_LANES 8
+#else
+#define BATCH_LANES 4
+#endif
+
+typedef double batch_t __attribute__((vector_size(BATCH_LANES * sizeof(double))));
+typedef long long batch_mask_t __attribute__((vector_size(BATCH_LANES * sizeof(long long))));
+
+inline batch_t batchSelect(batch_mask_t mask, batch_t a, batch_t b) {
+    return (batch_t)(((batch_mask_t)a & mask) | ((batch_mask_t)b & ~mask));
+}
 
 extern size_t const kAlgorithmTranspose;
 extern size_t const kAlgorithmStatic;
 
+extern size_t const kBackendMpi;
+extern size_t const kBackendThreads;
+
+extern size_t const kNonlinearPicard;
+extern size_t const kNonlinearNewton;
+extern size_t const kNonlinearAnderson;
+
 class Factors {
+public:
+
+    /**
+     *  Interval [T0 + i * step, T0 + (i + 1) * step] of the properties table.
+     *  Values are one-sided limits, so phase jumps at TSol and TLik fall on nodes exactly.
+     */
+    struct PropertiesNode {
+        double lambda, lambdaSlope, roC, roCSlope;
+    };
+
+private:
     Config *_config;
 
     double _x1, _x2, _totalTime,
         _x1SplitCount, _x2SplitCount, _timeSplitCount, _epsilon, _tMax,
         _TStart, _TEnv, _TEnv4, _balanceFactor, _transposeBalancingFactor,
-        _transposeBalancingTimeFactor, _staticBalancingThresholdFactor;
+        _transposeBalancingTimeFactor, _staticBalancingThresholdFactor, _balanceHeadroom;
     bool _balancing, _enableConsole, _enablePlot, _enableMatrix, _enableBuckets, _enableWeights, _enableTimes,
-        _enableBalanceWeightsSmooth;
+        _enableBalanceWeightsSmooth, _enableBatchedRows, _enableFusedRows, _enableLiquidRows,
+        _enablePropertiesCache, _enableHugePages, _enableNumaBinding,
+        _enableColumnSweeps, _enablePredictorBaseline;
+    size_t _nonlinearSolver, _andersonDepth, _predictorOrder, _threads;
+    size_t _backend, _ranks;
+    bool _enableProgressThread;
     size_t _minimumBundle, _viewCount, _debugView, _framesCount, _repeats, _transposeIterations, _algorithm;
     std::vector<double> _x1View, _x2View;
     std::string _plotFilename, _bucketsFilename, _weightsFilename, _timesFilenamePrefix;
 
+    std::vector<PropertiesNode> _propertiesTable;
+    double _propertiesTableT0, _propertiesTableInvStep, _propertiesTableMaxIndex, _propertiesTableError;
+    double _propertiesCacheTolerance;
+
     void initFactors(Config config);
+    void initPropertiesTable(double step, double tolerance);
+    double buildPropertiesTable(double step);
+
+    const PropertiesNode &propertiesNode(double T, double &offset) const;
 
 public:
 
@@ -38,6 +83,43 @@ public:
 
     double lambda(double T) const;
     double ro(double T) const;
+    double roC(double T) const;
+
+    double analyticLambda(double T) const;
+    double analyticRoC(double T) const;
+
+    /**
+     *  At and above the liquidus lambda and ro * cEf do not depend on T.
+     */
+    double TLiquidus() const;
+    double liquidLambda() const;
+    double liquidRoC() const;
+
+    /**
+     *  Batch evaluation of `lambda[i] = lambda(T[i])` and `roC[i] = roC(T[i])`.
+     */
+    void evaluate(const double *T, size_t n, double *lambda, double *roC) const;
+
+    /**
+     *  Same as `evaluate` plus derivatives by T. Derivatives are taken inside the phase of T[i],
+     *  so latent heat jumps at TSol and TLik do not show up as spikes.
+     */
+    void evaluateDerivatives(const double *T, size_t n, double *lambda, double *roC,
+                             double *dLambda, double *dRoC) const;
+
+    /**
+     *  Incremental `evaluate`: `lambda[i]` and `roC[i]` were computed at `Tc[i]` and are refreshed
+     *  only when T[i] moved by more than `tolerance` or crossed TSol or TLik. NaN in `Tc` forces refresh.
+     */
+    void evaluateChanged(const double *T, size_t n, double *Tc, double *lambda, double *roC,
+                         double tolerance) const;
+
+    bool EnablePropertiesCache() const;
+    double PropertiesCacheTolerance() const;
+
+    bool EnablePropertiesTable() const;
+    double PropertiesTableStep() const;
+    double PropertiesTableError() const;
 
     double X1() const;
     double X2() const;
@@ -57,9 +139,36 @@ public:
     size_t TransposeBalanceIterationsInterval() const;
     double TransposeBalanceTimeFactor() const;
     double StaticBalanceThresholdFactor() const;
+    double BalanceHeadroom() const;
     bool EnableBalanceWeightsSmooth() const;
+    bool EnableHugePages() const;
+    bool EnableNumaBinding() const;
 
     size_t Algorithm() const;
+    bool EnableBatchedRows() const;
+
+    /**
+     *  Fused kernel solves Picard rows with both borders. Batched rows go first, so it runs only without them.
+     */
+    bool EnableFusedRows() const;
+    bool EnableLiquidRows() const;
+    bool EnableColumnSweeps() const;
+    size_t NonlinearSolver() const;
+    size_t AndersonDepth() const;
+    size_t PredictorOrder() const;
+
+    /**
+     *  Diagnostic: sampled rows of predicted steps are solved once more without the guess. Adds work to the step.
+     */
+    bool EnablePredictorBaseline() const;
+    size_t Threads() const;
+    size_t Backend() const;
+    size_t Ranks() const;
+
+    /**
+     *  Pipeline messages of the static algorithm go through a thread of every rank, MPI backend only.
+     */
+    bool EnableProgressThread() const;
 
     double TStart() const;
     double TEnv() const;
@@ -86,4 +195,31 @@ public:
 
 };
 
+inline const Factors::PropertiesNode &Factors::propertiesNode(double T, double &offset) const {
+    double x = (T - _propertiesTableT0) * _propertiesTableInvStep;
+    size_t index = (size_t)std::min(std::max(x, 0.0), _propertiesTableMaxIndex);
+    offset = x - index;
+    return _propertiesTable[index];
+}
+
+inline double Factors::lambda(double T) const {
+    if (_propertiesTable.empty()) {
+        return analyticLambda(T);
+    }
+
+    double offset;
+    const PropertiesNode &node = propertiesNode(T, offset);
+    return node.lambda + offset * node.lambdaSlope;
+}
+
+inline double Factors::roC(double T) const {
+    if (_propertiesTable.empty()) {
+        return analyticRoC(T);
+    }
+
+    double offset;
+    const PropertiesNode &node = propertiesNode(T, offset);
+    return node.roC + offset * node.roCSlope;
+}
+
 #endif /* defined(__Diploma__factors__) */
@@ -59,18 +59,13 @@ std::ostream &Field::debug(bool info) {
 }
 
 void Field::calculateNBS() {
-    MPI_Barrier(MPI_COMM_WORLD);
+    comm->barrier();
     startSyncTime = bx_clock_t::now();
 
-    MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
-
-    int dims[] = { numProcs };
-    int wrap[] = { 0 };
-    MPI_Cart_create(MPI_COMM_WORLD, 1, dims, wrap, 1, &comm);
-
-    MPI_Comm_rank(comm, &myId);
-    MPI_Cart_coords(comm, myId, 1, &myCoord);
-    MPI_Cart_shift(comm, 0, 1, &topN, &bottomN);
+    numProcs = comm->Size();
+    myId = comm->Rank();
+    myCoord = comm->Coord();
+    comm->neighbours(&topN, &bottomN);
     rightN = leftN = NOBODY;
 
     height /= numProcs;
@@ -82,18 +77,102 @@ void Field::calculateNBS() {
     printf("I'm %d(%d)\n", myId, ::getpid());
     int waiter = myId;
     while (waiter == WAITER) sleep(5);
-    MPI_Barrier(MPI_COMM_WORLD);
+    comm->barrier();
 #endif
 }
 
 void Field::finalize() {
+    ++finishedRepeats;
+    if (algo::ftr().EnableConsole() == false) {
+        return;
+    }
+
+    // Row iterations per independent-rows half step, to compare predictor settings
+    unsigned long long local[6] = {rowIterations, rowStepsRows, predictedSteps,
+                                   sampledRows, sampledIterations, baselineIterations};
+    unsigned long long total[6] = {0, 0, 0, 0, 0, 0};
+    comm->reduce(local, total, 6, Communicator::kSum, MASTER);
+    if (myId == MASTER && total[1] > 0) {
+        printf("Row iterations\tper row: %.3f\tpredicted steps: %llu of %zu\n",
+               (double)total[0] / total[1], total[2] / numProcs, rowSteps);
+    }
+    if (myId == MASTER && total[3] > 0) {
+        // Sampled rows of predicted steps against the same rows solved from `prev`
+        double savedPerRow = ((double)total[5] - total[4]) / total[3];
+        printf("Predictor\tsaved per row: %.3f of %.3f\tsaved per step: %.1f\n",
+               savedPerRow, (double)total[5] / total[3], savedPerRow * total[1] / rowSteps);
+    }
+
+    // Ranges moved between threads of the busiest rank
+    if (pool != NULL) {
+        unsigned long long steals = pool->Steals(), maxSteals = 0;
+        comm->reduce(&steals, &maxSteals, 1, Communicator::kMax, MASTER);
+        if (myId == MASTER) {
+            printf("Row threads\tper rank: %zu\tsteals: %llu\n", pool->Workers(), maxSteals);
+        }
+    }
+
+    // Memory is kept by the following repeats, so it is reported after the last one
+    if (finishedRepeats < algo::ftr().Repeats()) {
+        return;
+    }
+
+    // Solver memory of the busiest rank and of all ranks
+    unsigned long long bytes = algo::arena().PeakBytes();
+    unsigned long long maxBytes = 0, sumBytes = 0;
+    comm->reduce(&bytes, &maxBytes, 1, Communicator::kMax, MASTER);
+    comm->reduce(&bytes, &sumBytes, 1, Communicator::kSum, MASTER);
+    if (myId == MASTER) {
+        printf("Arena peak\tper rank: %.2f MB\ttotal: %.2f MB\n", maxBytes / 1048576.0, sumBytes / 1048576.0);
+    }
+
+    // Current and peak bytes of every category on the busiest rank, and peaks of all ranks
+    size_t const count = Arena::kCategoryCount;
+    unsigned long long categories[2 * count], maxCategories[2 * count], sumPeaks[count];
+    for (size_t c = 0; c < count; ++c) {
+        categories[c] = algo::arena().BytesInUse((Arena::Category)c);
+        categories[count + c] = algo::arena().PeakBytes((Arena::Category)c);
+    }
+    comm->reduce(categories, maxCategories, 2 * count, Communicator::kMax, MASTER);
+    comm->reduce(categories + count, sumPeaks, count, Communicator::kSum, MASTER);
+    if (myId == MASTER) {
+        for (size_t c = 0; c < count; ++c) {
+            if (maxCategories[count + c] > 0) {
+                printf("Memory %s\tcurrent: %.2f MB\tpeak: %.2f MB\ttotal peak: %.2f MB\n",
+                       Arena::categoryName((Arena::Category)c), maxCategories[c] / 1048576.0,
+                       maxCategories[count + c] / 1048576.0, sumPeaks[c] / 1048576.0);
+            }
+        }
+    }
+
+    // Pages of the field layers on the NUMA node of their rank, placement is queried only when bound
+    if (algo::ftr().EnableNumaBinding() == false) {
+        return;
+    }
+    unsigned long long pages[3] = {0, 0, 1};
+    double *layers[] = {prev, curr, buff};
+    for (size_t i = 0; i < 3; ++i) {
+        size_t local = 0, placed = 0;
+        pages[2] &= Arena::pagePlacement(layers[i], capacity * sizeof(double), &local, &placed);
+        pages[0] += local;
+        pages[1] += placed;
+    }
+    unsigned long long totalPages[3] = {0, 0, 0};
+    comm->reduce(pages, totalPages, 3, Communicator::kSum, MASTER);
+    if (myId == MASTER) {
+        if (totalPages[2] == (unsigned long long)numProcs) {
+            printf("Layer pages\tlocal: %llu of %llu\n", totalPages[0], totalPages[1]);
+        } else {
+            printf("Layer pages\tplacement unknown\n");
+        }
+    }
 }
 
 void Field::reduceViews() {
     for (size_t index = 0, len = algo::ftr().ViewCount(); index < len; ++index) {
         double value = view(index);
         double result = 0;
-        MPI_Reduce(&value, &result, 1, MPI_DOUBLE, MPI_MAX, MASTER, comm);
+        comm->reduce(&value, &result, 1, Communicator::kMax, MASTER);
         views[index] = result;
     }
 }
@@ -107,10 +186,9 @@ void Field::printMatrix() {
                 }
                 mfout = new std::ofstream("matrix.csv", std::ios::app);
                 
-                size_t index = 0;
                 for (size_t row = (topN == NOBODY ? 0 : 1); row < height - (bottomN == NOBODY ? 0 : 1); ++row) {
-                    for (size_t col = 0; col < width; ++col, ++index) {
-                        *mfout << curr[index];
+                    for (size_t col = 0; col < width; ++col) {
+                        *mfout << curr[row * pitch + col];
                         if (col < width - 1) {
                             *mfout << " ";
                         }
@@ -125,7 +203,7 @@ void Field::printMatrix() {
                 delete mfout;
                 mfout = NULL;
             }
-            MPI_Barrier(comm);
+            comm->barrier();
         }
     }
 }
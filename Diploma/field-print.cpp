@@ -22,32 +22,31 @@ double Field::view(double x1, double x2) {
     /*double x1factor = x1 - x1index * hX;
      double x2factor = x2 - x2index * hY;
 
-     double value = curr[x2index * width + x1index] + x1factor * curr[x2index * width + x1index + 1];
-     value += x2factor * (curr[(x2index + 1) * width + x1index] + x1factor * curr[(x2index + 1) * width + x1index + 1]);*/
+     double value = curr[x2index * pitch + x1index] + x1factor * curr[x2index * pitch + x1index + 1];
+     value += x2factor * (curr[(x2index + 1) * pitch + x1index] + x1factor * curr[(x2index + 1) * pitch + x1index + 1]);*/
 
-    return curr[x2index * width + x1index];
+    return curr[x2index * pitch + x1index];
 }
 
 double Field::view(size_t index) {
     return view(algo::ftr().X1View(index), algo::ftr().X2View(index));
 }
 
+// Streams are opened by the first repeat, the following ones append to them
 void Field::enablePlotOutput() {
     if (myId != MASTER) {
         return;
     }
 
     if (fout != NULL) {
-        fout->close();
-        delete fout;
+        return;
     }
     fout = new std::ofstream(algo::ftr().PlotFilename());
 }
 
 void Field::enableMatrixOutput() {
     if (mfout != NULL) {
-        mfout->close();
-        delete mfout;
+        return;
     }
     mfout = new std::ofstream("matrix.csv", std::ios::trunc);
 }
@@ -58,8 +57,7 @@ void Field::enableBucketsOutput() {
     }
     
     if (bfout != NULL) {
-        bfout->close();
-        delete bfout;
+        return;
     }
     bfout = new std::ofstream(algo::ftr().BucketsFilename());
     for (size_t i = 0; i < numProcs; ++i) {
@@ -77,8 +75,7 @@ void Field::enableWeightsOutput() {
     }
 
     if (wfout != NULL) {
-        wfout->close();
-        delete wfout;
+        return;
     }
     wfout = new std::ofstream(algo::ftr().WeightsFilename());
     for (size_t i = 0, len = weightsSize(); i < len; ++i) {
@@ -92,8 +89,7 @@ void Field::enableWeightsOutput() {
 
 void Field::enableTimesOutput() {
     if (tfout != NULL) {
-        tfout->close();
-        delete tfout;
+        return;
     }
     char nameBuff[255] = {0};
     sprintf(nameBuff, "%s.%lu.csv", algo::ftr().TimesFilenamePrefix().data(), (long)myCoord);
@@ -138,20 +134,34 @@ void Field::printTimes() {
     
 }
 
+void Field::printMemoryHeaders() {
+    for (size_t c = 0; c < Arena::kCategoryCount; ++c) {
+        const char *name = Arena::categoryName((Arena::Category)c);
+        *tfout << "," << name << "-bytes" << "," << name << "-peak-bytes";
+    }
+}
+
+void Field::printMemory() {
+    for (size_t c = 0; c < Arena::kCategoryCount; ++c) {
+        *tfout << "," << algo::arena().BytesInUse((Arena::Category)c)
+               << "," << algo::arena().PeakBytes((Arena::Category)c);
+    }
+}
+
 void Field::testPrint() {
-    MPI_Barrier(comm);
+    comm->barrier();
     sleep(1);
 
     for (int p = 0; p < numProcs; ++p) {
         if (p == myCoord) {
-            for (int i = 0, index = 0; i < height; ++i) {
-                for (int j = 0; j < width; ++j, ++index) {
-                    printf("%.0f\t", prev[index]);
+            for (int i = 0; i < height; ++i) {
+                for (int j = 0; j < width; ++j) {
+                    printf("%.0f\t", prev[i * pitch + j]);
                 }
                 printf("\n");
             }
         }
-        MPI_Barrier(comm);
+        comm->barrier();
         sleep(1);
     }
 }
@@ -6,45 +6,65 @@
 #include "algo.h"
 #include "balancing.h"
 #include <cmath>
+#include <deque>
 
 #include <sys/types.h>
 #include <unistd.h>
 
+FieldStatic::FieldStatic(Communicator *comm) : Field(comm) {
+    nowBuckets = nextBuckets = NULL;
+}
+
 void FieldStatic::init() {
     Field::init();
 }
 
 FieldStatic::~FieldStatic() {
+    if (nowBuckets == NULL) {
+        return;
+    }
+
     delete[] calculatingRows;
     delete[] nextCalculatingRows;
 
-    delete[] sendBuff;
-    delete[] receiveBuff;
+    algo::arena().release(sendBuff);
+    algo::arena().release(receiveBuff);
 
-    delete[] weights;
+    algo::arena().release(weights);
 
     delete[] nowBuckets;
     delete[] nextBuckets;
-
-    delete[] balanceRequests;
-    
-    MPI_Comm_free(&firstPassComm);
-    MPI_Comm_free(&secondPassComm);
-    MPI_Comm_free(&calculatingRowsComm);
-    MPI_Comm_free(&balanceComm);
 }
 
 void FieldStatic::finalize() {
-    MPI_Barrier(MPI_COMM_WORLD);
+    Field::finalize();
+    comm->waitSends();
+    comm->barrier();
 }
 
 void FieldStatic::calculateNBS() {
     Field::calculateNBS();
 
     fullHeight = algo::ftr().X2SplitCount();
+    columnSweeps = algo::ftr().EnableColumnSweeps();
+
+    // Buffers are created once and reused by the following repeats
+    if (nowBuckets == NULL) {
+        nowBuckets = new size_t[numProcs];
+        nextBuckets = new size_t[numProcs];
+
+        calculatingRows = new bool[width];
+        nextCalculatingRows = new bool[width];
+
+        sendBucketSize = width + numProcs;
+        sendBuff = algo::arena().allocDoubles(Arena::kMessages, width * sendBucketSize, algo::ftr().EnableHugePages());
+
+        // One message at a time: bundle flag, weights or buckets, and 4 values per row
+        receiveBuff = algo::arena().allocDoubles(Arena::kMessages, messageSize(numProcs));
+
+        weights = algo::arena().allocDoubles(Arena::kOther, fullHeight);
+    }
 
-    nowBuckets = new size_t[numProcs];
-    nextBuckets = new size_t[numProcs];
     for (size_t i = 0; i < numProcs - 1; ++i) {
         nowBuckets[i] = height;
     }
@@ -60,48 +80,52 @@ void FieldStatic::calculateNBS() {
 
     height += (topN != NOBODY ? 1 : 0) + (bottomN != NOBODY ? 1 : 0);
 
-    calculatingRows = new bool[width];
-    nextCalculatingRows = new bool[width];
-
-    sendBucketSize = width + numProcs;
-    sendBuff = new double[width * sendBucketSize];
-    receiveBuff = new double[width * sendBucketSize];
-
     lastIterationsCount = lastWaitingCount = 0;
 
-    MPI_Comm_dup(comm, &firstPassComm);
-    MPI_Comm_dup(comm, &secondPassComm);
-    MPI_Comm_dup(comm, &calculatingRowsComm);
-    MPI_Comm_dup(comm, &balanceComm);
-
-    balanceRequests = new MPI_Request[numProcs * 2];
-
     bundleSizeLimit = std::max(ceil((double)width / numProcs / 2), 15.0);
     printf("I'm %d(%d)\twith w:%zu\th:%zu\tbs:%zu.\tTop:%d\tbottom:%d\n",
            myId, ::getpid(), width, height, bundleSizeLimit, topN, bottomN);
 
-    weights = new double[fullHeight];
     memset(weights, 0, fullHeight * sizeof(double));
 }
 
+size_t FieldStatic::messageSize(size_t numProcs) {
+    return 1 + numProcs + (size_t)algo::ftr().X2SplitCount() + 4 * (size_t)algo::ftr().X1SplitCount();
+}
+
 #pragma mark - Logic
 
 void FieldStatic::transpose(double **arr) {
-    for (size_t index = 0, len = width * height; index < len; ++index) {
-        size_t newIndex = (index % width) * height + index / width;
-        buff[newIndex] = (*arr)[index];
-    }
+    // Padding of the shorter rows may not fit into the block reserved for the longer ones
+    size_t transposedPitch = Arena::rowStride(height);
+    reserve(width * transposedPitch);
+    algo::transpose(*arr, buff, height, width, pitch, transposedPitch);
     std::swap(*arr, buff);
 }
 
+bool FieldStatic::keepsCoefficients() {
+    // Pipelined passes keep every row of a bundle between the first and the second pass
+    return true;
+}
+
+size_t FieldStatic::cellIndex(size_t row, size_t index) {
+    return columnSweeps && transposed ? index * pitch + row : row * pitch + index;
+}
+
 void FieldStatic::transpose() {
-    transpose(transposed ? &curr : &prev);
+    // With column sweeps only the roles of rows and columns are swapped
+    if (columnSweeps == false) {
+        transpose(transposed ? &curr : &prev);
+    }
 
     std::swap(hX, hY);
     std::swap(mySX, mySY);
     std::swap(topN, leftN);
     std::swap(bottomN, rightN);
     std::swap(width, height);
+    if (columnSweeps == false) {
+        pitch = Arena::rowStride(width);
+    }
     transposed = transposed == false;
 }
 
@@ -111,65 +135,236 @@ void FieldStatic::resetCalculatingRows() {
     }
 }
 
-size_t FieldStatic::firstPasses(size_t fromRow, bool first, bool async) {
-    if (async && checkIncomingFirstPass(fromRow) == false) {
-        return 0;
+size_t FieldStatic::bundleEnd(size_t fromRow) {
+    size_t row = fromRow;
+    for (size_t bundleSize = 0; row < height && bundleSize < bundleSizeLimit; ++row) {
+        bundleSize += calculatingRows[row];
     }
+    return row;
+}
 
-    bool shouldProcess = recieveFirstPass(fromRow, first); // (crf + b + c + f) x [calculatingRows]
+bool FieldStatic::sweep(bool first) {
+    // Bundles in flight in the order of rows. Only the last one may wait for its first pass,
+    // rows of the next bundle are known once that message came
+    std::deque<BundleTask> tasks;
+    BundleTask start = {0, 0, BundleTask::kFirstPass};
+    tasks.push_back(start);
+
+    std::vector<BundleTask *> ready;
+    while (tasks.empty() == false) {
+        START_TIME(wStart);
+        bool waited = false;
+        for (;;) {
+            // Second passes go first, they let the left neighbour finish its iteration
+            for (auto it = tasks.begin(); it != tasks.end(); ++it) {
+                if (it->stage == BundleTask::kSecondPass && checkIncomingSecondPass(it->fromRow)) {
+                    ready.push_back(&*it);
+                }
+            }
+            BundleTask &last = tasks.back();
+            if (last.stage == BundleTask::kFirstPass && checkIncomingFirstPass(last.fromRow)) {
+                ready.push_back(&last);
+            }
+
+            if (ready.empty() == false) {
+                break;
+            }
+            waited = true;
+            comm->idle();
+        }
+        if (waited) {
+            END_TIME(syncNetworkTime, wStart);
+            END_TIME(syncNetworkWithPrepTime, wStart);
+        }
+
+        for (size_t i = 0; i < ready.size(); ++i) {
+            BundleTask &task = *ready[i];
+            if (task.stage == BundleTask::kFirstPass) {
+                if (recieveFirstPass(task.fromRow, first) == false) { // (crf + b + c + f) x [calculatingRows]
+                    return false;
+                }
+                task.toRow = bundleEnd(task.fromRow);
+                if (task.toRow < height) {
+                    BundleTask next = {task.toRow, 0, BundleTask::kFirstPass};
+                    tasks.push_back(next);
+                }
+            } else {
+                if (myCoord == 0) {
+                    // A wait is counted once, messages that came during it were not waited for each
+                    ++lastIterationsCount;
+                    lastWaitingCount += waited;
+                    waited = false;
+                }
+                recieveSecondPass(task.fromRow); // (nextCalculatingRows + y) x [prevCalculatingRows]
+            }
+        }
+
+        runBundles(ready.data(), ready.size(), first);
+        ready.clear();
 
-    if (shouldProcess == false) {
-        // Sorry for that "workaround"
-        return height * 2;
+        while (tasks.empty() == false && tasks.front().stage == BundleTask::kDone) {
+            tasks.pop_front();
+        }
     }
 
-    size_t row = fromRow;
-    for (size_t bundleSize = 0; row < height && bundleSize < bundleSizeLimit; ++row) {
+    return true;
+}
+
+void FieldStatic::runBundles(BundleTask *const *tasks, size_t count, bool first) {
+    // Without the team every bundle is sent as soon as it is computed
+    size_t batch = pool == NULL ? 1 : count;
+
+    std::vector<BundlePass> passes(count);
+    for (size_t i = 0; i < count; ++i) {
+        BundlePass pass = {tasks[i]->fromRow, tasks[i]->toRow, tasks[i]->stage == BundleTask::kSecondPass};
+        passes[i] = pass;
+    }
+
+    for (size_t from = 0; from < count; from += batch) {
+        size_t to = std::min(from + batch, count);
+        computePasses(passes.data() + from, to - from, first);
+
+        for (size_t i = from; i < to; ++i) {
+            BundleTask &task = *tasks[i];
+            if (task.stage == BundleTask::kFirstPass) {
+                sendFirstPass(task.fromRow); // (crf + b + c + f) x [calculatingRows]
+                task.stage = BundleTask::kSecondPass;
+            } else {
+                sendSecondPass(task.fromRow); // (nextCalculatingRows + y) x [prevCalculatingRows]
+                task.stage = BundleTask::kDone;
+            }
+        }
+    }
+}
+
+void FieldStatic::computePasses(const BundlePass *passes, size_t count, bool first) {
+    if (pool == NULL) {
+        for (size_t i = 0; i < count; ++i) {
+            computePass(workspaces[0], passes[i], passes[i].fromRow, passes[i].toRow, first);
+        }
+        return;
+    }
+
+    // Chunks of about equal count of calculating rows, not narrower than a batch
+    size_t const workers = pool->Workers();
+    std::vector<BundlePass> chunks;
+    for (size_t i = 0; i < count; ++i) {
+        size_t rows = 0;
+        for (size_t row = passes[i].fromRow; row < passes[i].toRow; ++row) {
+            rows += calculatingRows[row];
+        }
+        size_t chunkRows = std::max((rows + workers - 1) / workers, algo::kBatchLanes);
+
+        BundlePass chunk = passes[i];
+        for (size_t row = passes[i].fromRow, inChunk = 0; row < passes[i].toRow; ++row) {
+            inChunk += calculatingRows[row];
+            if (inChunk == chunkRows || row + 1 == passes[i].toRow) {
+                chunk.toRow = row + 1;
+                chunks.push_back(chunk);
+                chunk.fromRow = row + 1;
+                inChunk = 0;
+            }
+        }
+    }
+
+    pool->run(chunks.size(), [this, &chunks, first](size_t item, size_t worker) {
+        computePass(workspaces[worker], chunks[item], chunks[item].fromRow, chunks[item].toRow, first);
+    });
+}
+
+void FieldStatic::computePass(Workspace &w, const BundlePass &pass, size_t fromRow, size_t toRow, bool first) {
+    if (columnSweeps) {
+        if (pass.second) {
+            secondPassColumns(w, fromRow, toRow, first);
+        } else {
+            firstPassColumns(w, fromRow, toRow, first);
+        }
+        return;
+    }
+
+    for (size_t row = fromRow; row < toRow; ++row) {
         if (calculatingRows[row] == false) {
+            if (pass.second) {
+                nextCalculatingRows[row] = false;
+            }
             continue;
         }
 
-        fillFactors(row, first);
-        firstPass(row);
-        ++bundleSize;
+        if (pass.second) {
+            double delta = secondPass(w, coefficients(row), row, first);
+            nextCalculatingRows[row] = (rightN == NOBODY ? false : nextCalculatingRows[row]) || delta > epsilon;
+        } else {
+            RowCoefficients k = coefficients(row);
+            size_t liquid = fillFactors(w, k, row, first);
+            firstPass(w, k, liquid);
+        }
     }
-    sendFirstPass(fromRow); // (crf + b + c + f) x [calculatingRows]
+}
 
-    return row;
+Field::RowCoefficients FieldStatic::columnCoefficients(size_t row) {
+    // Coefficients of columns are laid out as the block, cell `index` is `pitch` cells after `index - 1`
+    size_t offset = row * algo::kCoefficientsStride;
+    const RowCoefficients &m = coefficientsMatrix;
+    RowCoefficients k = { m.aF + offset, m.bF + offset, m.cF + offset, m.fF + offset };
+    return k;
 }
 
-size_t FieldStatic::secondPasses(size_t fromRow, bool first, bool async) {
-    if (checkIncomingSecondPass(fromRow) == false) {
-        if (async) {
-            return 0;
+void FieldStatic::firstPassColumns(Workspace &w, size_t fromRow, size_t toRow, bool first) {
+    START_TIME(start);
+
+    // Row buffers hold properties of the bundle for three cells of the sweep
+    double *lm[] = { w.lmF, w.rcF, w.pF };
+    double *rc[] = { w.qF, w.dlmF };
+
+    // Converged columns are skipped, runs of calculating ones are swept together
+    for (size_t row = fromRow; row < toRow;) {
+        if (calculatingRows[row] == false) {
+            ++row;
+            continue;
         }
-        else if (myCoord == 0) {
-            ++lastWaitingCount;
+        size_t runEnd = row + 1;
+        while (runEnd < toRow && calculatingRows[runEnd]) {
+            ++runEnd;
         }
-    }
 
-    if (myCoord == 0) {
-        ++lastIterationsCount;
+        RowCoefficients k = columnCoefficients(row);
+        double *rw = prev + row;
+        double *brw = (first ? prev : curr) + row;
+        algo::fillColumns(rw, brw, width, runEnd - row, pitch, k.aF, k.bF, k.cF, k.fF,
+                          lm, rc, rowK, leftN == NOBODY, rightN == NOBODY);
+        algo::firstPassColumns(width, runEnd - row, pitch, k.aF, k.bF, k.cF, k.fF, rightN == NOBODY, w.lmF, w.rcF);
+        row = runEnd;
     }
 
-    recieveSecondPass(fromRow); // (nextCalculatingRows + y) x [prevCalculatingRows]
+    END_TIME(w.calculationsTime, start);
+}
 
-    size_t row = fromRow;
-    for (size_t bundleSize = 0; row < height && bundleSize < bundleSizeLimit; ++row) {
+void FieldStatic::secondPassColumns(Workspace &w, size_t fromRow, size_t toRow, bool first) {
+    START_TIME(start);
+
+    double *delta = w.drcF;
+    for (size_t row = fromRow; row < toRow;) {
         if (calculatingRows[row] == false) {
-            nextCalculatingRows[row] = false;
+            nextCalculatingRows[row++] = false;
             continue;
         }
+        size_t runEnd = row + 1;
+        while (runEnd < toRow && calculatingRows[runEnd]) {
+            ++runEnd;
+        }
 
-        double delta = secondPass(row, first);
-
-        nextCalculatingRows[row] = (rightN == NOBODY ? false : nextCalculatingRows[row]) || delta > epsilon;
+        RowCoefficients k = columnCoefficients(row);
+        double *y = curr + row;
+        double *py = (first ? prev : curr) + row;
+        algo::secondPassColumns(py, y, width, runEnd - row, pitch, k.bF, k.cF, k.fF, rightN == NOBODY, delta, w.rcF);
 
-        ++bundleSize;
+        for (size_t runStart = row; row < runEnd; ++row) {
+            nextCalculatingRows[row] = (rightN == NOBODY ? false : nextCalculatingRows[row])
+                    || delta[row - runStart] > epsilon;
+        }
     }
-    sendSecondPass(fromRow); // (nextCalculatingRows + y) x [prevCalculatingRows]
 
-    return row;
+    END_TIME(w.calculationsTime, start);
 }
 
 void FieldStatic::balanceBundleSize() {
@@ -184,6 +379,17 @@ void FieldStatic::balanceBundleSize() {
     lastWaitingCount = 0;
 }
 
+void FieldStatic::updateWeight(size_t row, size_t iterationsCount, double time) {
+    size_t firstRealRow = (topN == NOBODY ? 0 : 1);
+    size_t lastRealRow = height - firstRealRow - (bottomN ? 0 : 1);
+    if (firstRealRow <= row && row <= lastRealRow) {
+        weights[mySY + row - firstRealRow] =
+                weights[mySY + row - firstRealRow] * algo::ftr().TransposeBalanceFactor()
+                + iterationsCount * (1.0 - algo::ftr().TransposeBalanceTimeFactor())
+                + time * algo::ftr().TransposeBalanceTimeFactor();
+    }
+}
+
 size_t FieldStatic::solveRows() {
     size_t maxIterationsCount = 0;
 
@@ -207,42 +413,7 @@ size_t FieldStatic::solveRows() {
 
         bool solving = true;
         while (solving) {
-            size_t fromFirstPassRow = 0;
-            size_t fromSecondPassRow = 0;
-
-            while (fromSecondPassRow < height) {
-                size_t nextSecondPassRow = 0;
-                if (fromSecondPassRow < height && fromFirstPassRow > fromSecondPassRow) {
-                    nextSecondPassRow = secondPasses(fromSecondPassRow, first, true);
-                }
-
-                size_t nextFirstPassRow = 0;
-                if (fromFirstPassRow < height) {
-                    nextFirstPassRow = firstPasses(fromFirstPassRow, first, true);
-                }
-
-                if (nextFirstPassRow == 0 && nextSecondPassRow == 0) {
-                    if (fromFirstPassRow < height) {
-                        nextFirstPassRow = firstPasses(fromFirstPassRow, first, false);
-                    }
-                    else {
-                        nextSecondPassRow = secondPasses(fromSecondPassRow, first, false);
-                    }
-                }
-
-                if (nextFirstPassRow > 0) {
-                    if (nextFirstPassRow == height * 2) {
-                        solving = false;
-                        break;
-                    }
-                    fromFirstPassRow = nextFirstPassRow;
-                }
-                if (nextSecondPassRow > 0) {
-                    fromSecondPassRow = nextSecondPassRow;
-                }
-            }
-
-            if (solving == false) {
+            if (sweep(first) == false) {
                 break;
             }
 
@@ -274,32 +445,7 @@ size_t FieldStatic::solveRows() {
             shouldBalanceNext = false;
         }
 
-        size_t firstRealRow = (topN == NOBODY ? 0 : 1);
-        size_t lastRealRow = height - firstRealRow - (bottomN ? 0 : 1);
-        for (size_t row = 0; row < height; ++row) {
-            fillFactors(row, true);
-            double delta = solve(row, true);
-            size_t iterationsCount = 1;
-            auto startTime = picosecFromStart();
-
-            while (delta > epsilon) {
-                fillFactors(row, false);
-                delta = solve(row, false);
-                ++iterationsCount;
-
-                if (iterationsCount > MAX_ITTERATIONS_COUNT) {
-                    break;
-                }
-            }
-            maxIterationsCount = std::max(maxIterationsCount, iterationsCount);
-
-            if (firstRealRow <= row && row <= lastRealRow) {
-                weights[mySY + row - firstRealRow] =
-                        weights[mySY + row - firstRealRow] * algo::ftr().TransposeBalanceFactor()
-                        + iterationsCount * (1.0 - algo::ftr().TransposeBalanceTimeFactor())
-                        + (picosecFromStart() - startTime) * 1e-12 * algo::ftr().TransposeBalanceTimeFactor();
-            }
-        }
+        maxIterationsCount = solveIndependentRows();
     }
 
     if (transposed) {
@@ -335,17 +481,17 @@ void FieldStatic::sendFirstPass(size_t fromRow) {
                 continue;
             }
 
-            size_t index = row * width + width - 2;
+            const RowCoefficients &m = coefficientsMatrix;
+            size_t index = cellIndex(row, width - 2) * algo::kCoefficientsStride;
             sBuff[sSize++] = row;
-            sBuff[sSize++] = mbF[index];
-            sBuff[sSize++] = mcF[index];
-            sBuff[sSize++] = mfF[index];
+            sBuff[sSize++] = m.bF[index];
+            sBuff[sSize++] = m.cF[index];
+            sBuff[sSize++] = m.fF[index];
             ++bundleSize;
         }
 
-        MPI_Request request;
         START_TIME(rStart);
-        MPI_Isend(sBuff, sSize, MPI_DOUBLE, rightN, (int)fromRow, firstPassComm, &request);
+        comm->send(sBuff, sSize, rightN, (int)fromRow, Communicator::kFirstPass);
         END_TIME(syncNetworkTime, rStart);
         END_TIME(syncNetworkWithPrepTime, rStartWithPrep);
     }
@@ -353,9 +499,8 @@ void FieldStatic::sendFirstPass(size_t fromRow) {
 
 void FieldStatic::sendDoneAsFirstPass() {
     if (rightN != NOBODY) {
-        MPI_Request request;
         START_TIME(rStart);
-        MPI_Isend(NULL, 0, MPI_DOUBLE, rightN, 0, firstPassComm, &request);
+        comm->send(NULL, 0, rightN, 0, Communicator::kFirstPass);
         END_TIME(syncNetworkTime, rStart);
         END_TIME(syncNetworkWithPrepTime, rStart);
     }
@@ -366,9 +511,8 @@ bool FieldStatic::checkIncomingFirstPass(size_t fromRow) {
         return true;
     }
 
-    int flag;
-    MPI_Iprobe(leftN, (int)fromRow, firstPassComm, &flag, MPI_STATUS_IGNORE);
-    return flag;
+    size_t sSize;
+    return comm->probe(leftN, (int)fromRow, Communicator::kFirstPass, false, &sSize);
 }
 
 bool FieldStatic::recieveFirstPass(size_t fromRow, bool first) {
@@ -376,19 +520,12 @@ bool FieldStatic::recieveFirstPass(size_t fromRow, bool first) {
     if (leftN != NOBODY) {
         START_TIME(rStart);
 
-        MPI_Status status;
-        MPI_Probe(leftN, (int)fromRow, firstPassComm, &status);
-        int sSize;
-        MPI_Get_count(&status, MPI_DOUBLE, &sSize);
-
-        MPI_Request request;
-        MPI_Irecv(receiveBuff, sSize, MPI_DOUBLE, leftN, (int)fromRow, firstPassComm, &request);
+        size_t sSize;
+        comm->probe(leftN, (int)fromRow, Communicator::kFirstPass, true, &sSize);
+        comm->recv(receiveBuff, sSize, leftN, (int)fromRow, Communicator::kFirstPass);
         if (sSize == 0) {
-            MPI_Cancel(&request);
             sendDoneAsFirstPass();
             return false;
-        } else {
-            MPI_Wait(&request, MPI_STATUS_IGNORE);
         }
 
         END_TIME(syncNetworkTime, rStart);
@@ -414,10 +551,16 @@ bool FieldStatic::recieveFirstPass(size_t fromRow, bool first) {
             }
             calculatingRows[lastRow++] = true;
 
-            size_t index = row * width;
-            mbF[index] = receiveBuff[idxBuffer++];
-            mcF[index] = receiveBuff[idxBuffer++];
-            mfF[index] = receiveBuff[idxBuffer++];
+            const RowCoefficients &m = coefficientsMatrix;
+            size_t index = cellIndex(row, 0) * algo::kCoefficientsStride;
+            double b = m.bF[index] = receiveBuff[idxBuffer++];
+            m.cF[index] = receiveBuff[idxBuffer++];
+            double f = receiveBuff[idxBuffer++];
+            if (algo::kCorrectionCoefficients) {
+                // Our cell 1 is a halo value in the sent equation and a local cell here
+                f -= b * (first ? prev : curr)[cellIndex(row, 1)];
+            }
+            m.fF[index] = f;
         }
 
         if ((sSize - 1) / 4 < bundleSizeLimit) {
@@ -502,14 +645,13 @@ void FieldStatic::sendSecondPass(size_t fromRow) {
             if (calculatingRows[row] == false) {
                 continue;
             }
-            sBuff[sSize++] = (nextCalculatingRows[row] ? 1 : -1) * curr[row * width + 1];
+            sBuff[sSize++] = (nextCalculatingRows[row] ? 1 : -1) * curr[cellIndex(row, 1)];
 
             ++bundleSize;
         }
 
-        MPI_Request request;
         START_TIME(rStart);
-        MPI_Isend(sBuff, sSize, MPI_DOUBLE, leftN, (int)fromRow, secondPassComm, &request);
+        comm->send(sBuff, sSize, leftN, (int)fromRow, Communicator::kSecondPass);
         END_TIME(syncNetworkTime, rStart);
         END_TIME(syncNetworkWithPrepTime, rStartWithPrep);
     }
@@ -520,9 +662,8 @@ bool FieldStatic::checkIncomingSecondPass(size_t fromRow) {
         return true;
     }
 
-    int flag;
-    MPI_Iprobe(rightN, (int)fromRow, secondPassComm, &flag, MPI_STATUS_IGNORE);
-    return flag;
+    size_t sSize;
+    return comm->probe(rightN, (int)fromRow, Communicator::kSecondPass, false, &sSize);
 }
 
 void FieldStatic::recieveSecondPass(size_t fromRow) {
@@ -530,19 +671,16 @@ void FieldStatic::recieveSecondPass(size_t fromRow) {
     if (rightN != NOBODY) {
         START_TIME(rStart);
 
-        MPI_Status status;
-        MPI_Probe(rightN, (int)fromRow, secondPassComm, &status);
-        int sSize;
-        MPI_Get_count(&status, MPI_DOUBLE, &sSize);
-
-        MPI_Recv(receiveBuff, sSize, MPI_DOUBLE, rightN, (int)fromRow, secondPassComm, MPI_STATUS_IGNORE);
+        size_t sSize;
+        comm->probe(rightN, (int)fromRow, Communicator::kSecondPass, true, &sSize);
+        comm->recv(receiveBuff, sSize, rightN, (int)fromRow, Communicator::kSecondPass);
         END_TIME(syncNetworkTime, rStart);
 
-        sSize = 0;
-        bool shouldReceiveBuckets = receiveBuff[sSize++] > 0;
+        size_t idxBuffer = 0;
+        bool shouldReceiveBuckets = receiveBuff[idxBuffer++] > 0;
         if (shouldReceiveBuckets) {
             for (size_t i = 0; i < numProcs; ++i) {
-                nextBuckets[i] = receiveBuff[sSize++];
+                nextBuckets[i] = receiveBuff[idxBuffer++];
             }
             shouldBalanceNext = true;
         }
@@ -552,9 +690,9 @@ void FieldStatic::recieveSecondPass(size_t fromRow) {
                 continue;
             }
 
-            double value = receiveBuff[sSize++];
+            double value = receiveBuff[idxBuffer++];
             nextCalculatingRows[row] = value > 0;
-            curr[(row + 1) * width - 1] = nextCalculatingRows[row] ? value : -value;
+            curr[cellIndex(row, width - 1)] = nextCalculatingRows[row] ? value : -value;
 
             ++bundleSize;
         }
@@ -597,7 +735,9 @@ void FieldStatic::balance() {
     size_t myBucketEnd = mySY + subheight;
     size_t selfSendFrom = 0;
     //debug() << "> " << subheight << "  " << myBucketStart << " " << myBucketEnd << "\n"; debug(0).flush();
-    size_t reqIdx = 0;
+
+    // Received rows go to `buff`, which becomes `prev`
+    reserve((nextBuckets[myCoord] + topShift + bottomShift) * pitch);
 
     // SEND
     for (size_t i = 0; i < numProcs; ++i) {
@@ -631,8 +771,7 @@ void FieldStatic::balance() {
             if (i == myCoord) {
                 selfSendFrom = fromRow;
             } else {
-                MPI_Isend(prev + fromRow * width, (int)((toRow - fromRow) * width),
-                          MPI_DOUBLE, (int)i, 0, balanceComm, balanceRequests + reqIdx++);
+                comm->send(prev + fromRow * pitch, (toRow - fromRow) * pitch, (int)i, 0, Communicator::kBalance);
             }
         }
 
@@ -671,17 +810,16 @@ void FieldStatic::balance() {
 
         if (fromRow != toRow) {
             if (i == myCoord) {
-                memcpy(buff + fromRow * width, prev + selfSendFrom * width, (toRow - fromRow) * width * sizeof(double));
+                memcpy(buff + fromRow * pitch, prev + selfSendFrom * pitch, (toRow - fromRow) * pitch * sizeof(double));
             } else {
-                MPI_Irecv(buff + fromRow * width, (int)((toRow - fromRow) * width),
-                          MPI_DOUBLE, (int)i, 0, balanceComm, balanceRequests + reqIdx++);
+                comm->recv(buff + fromRow * pitch, (toRow - fromRow) * pitch, (int)i, 0, Communicator::kBalance);
             }
         }
 
         sy += nowBuckets[i];
     }
 
-    MPI_Waitall((int)reqIdx, balanceRequests, MPI_STATUSES_IGNORE);
+    comm->waitSends();
     std::swap(buff, prev);
     std::swap(nowBuckets, nextBuckets);
 
@@ -721,8 +859,9 @@ void FieldStatic::printTimeHeaders() {
             << "," << "sync-network-with-prep-time"
             << "," << "balancing-time"
             << "," << "partitioning-time"
-            << "," << "weights-smooth-time"
-            << "\n";
+            << "," << "weights-smooth-time";
+        printMemoryHeaders();
+        *tfout << "\n";
 
         fullIterationTime = calculationsTime = parallelPartTime = syncPartTime =
             syncNetworkTime = syncNetworkWithPrepTime = balancingTime = partitioningTime = weightsSmoothTime = 0;
@@ -739,8 +878,9 @@ void FieldStatic::printTimes() {
             << "," << syncNetworkWithPrepTime
             << "," << balancingTime
             << "," << partitioningTime
-            << "," << weightsSmoothTime
-            << "\n";
+            << "," << weightsSmoothTime;
+        printMemory();
+        *tfout << "\n";
 
         tfout->flush();
 
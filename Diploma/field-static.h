@@ -17,22 +17,82 @@ class FieldStatic : public Field {
     bool *calculatingRows, *nextCalculatingRows;
     double *sendBuff, *receiveBuff;
 
+    /**
+     *  Transposed half step sweeps columns of the untransposed block instead of transposing it.
+     */
+    bool columnSweeps;
+
+    /**
+     *  Position of cell `index` of row `row` in the block.
+     *  With column sweeps rows of the transposed half step are columns, `height` apart.
+     */
+    size_t cellIndex(size_t row, size_t index);
+
     void calculateNBS() override;
     void resetCalculatingRows();
 
-    size_t firstPasses(size_t fromRow, bool first, bool async);
-    size_t secondPasses(size_t fromRow, bool first, bool async);
+    /**
+     *  Pass over rows `[fromRow, toRow)` of one bundle.
+     */
+    struct BundlePass {
+        size_t fromRow, toRow;
+        bool second;
+    };
+
+    /**
+     *  Bundle of the pipelined sweep, a task that waits for the message of its first pass
+     *  and then for the one of its second pass. `toRow` is known once the first message came.
+     */
+    struct BundleTask {
+        enum Stage {
+            kFirstPass,
+            kSecondPass,
+            kDone
+        };
+
+        size_t fromRow, toRow;
+        Stage stage;
+    };
+
+    /**
+     *  Row after the bundle at `fromRow`, by `calculatingRows` and `bundleSizeLimit`.
+     */
+    size_t bundleEnd(size_t fromRow);
+
+    /**
+     *  One iteration of the pipeline: runs every bundle whose message is there and waits
+     *  for whichever comes first when none is.
+     *
+     *  @return false when the done message came instead of the first bundle
+     */
+    bool sweep(bool first);
+
+    /**
+     *  Computes the ready stages of `tasks` and sends their results.
+     */
+    void runBundles(BundleTask *const *tasks, size_t count, bool first);
+
+    /**
+     *  Rows of every bundle are split into chunks for the thread team, so passes of two bundles
+     *  may run together. Only the main thread calls MPI, before and after.
+     */
+    void computePasses(const BundlePass *passes, size_t count, bool first);
+    void computePass(Workspace &w, const BundlePass &pass, size_t fromRow, size_t toRow, bool first);
+
+    RowCoefficients columnCoefficients(size_t row);
+    void firstPassColumns(Workspace &w, size_t fromRow, size_t toRow, bool first);
+    void secondPassColumns(Workspace &w, size_t fromRow, size_t toRow, bool first);
 
     void transpose(double **arr);
     void transpose() override;
+    bool keepsCoefficients() override;
 
     size_t solveRows() override;
+    void updateWeight(size_t row, size_t iterationsCount, double time) override;
 
     void sendRecieveCalculatingRows();
     void balanceBundleSize();
 
-    MPI_Comm firstPassComm, secondPassComm, calculatingRowsComm;
-
     void sendFirstPass(size_t fromRow);
     void sendDoneAsFirstPass();
     bool checkIncomingFirstPass(size_t fromRow);
@@ -46,9 +106,6 @@ class FieldStatic : public Field {
 
 #pragma makr - Balancing
 
-    MPI_Comm balanceComm;
-    MPI_Request *balanceRequests;
-
     size_t *nowBuckets, *nextBuckets;
     bool shouldSendWeights, shouldBalanceNext;
 
@@ -67,6 +124,13 @@ class FieldStatic : public Field {
     void printTimes() override;
     
 public:
+    explicit FieldStatic(Communicator *comm);
+
+    /**
+     *  Values of the largest pipeline message between `numProcs` ranks, `receiveBuff` holds one.
+     */
+    static size_t messageSize(size_t numProcs);
+
     ~FieldStatic();
 
     void init() override;
@@ -10,6 +10,10 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+FieldTranspose::FieldTranspose(Communicator *comm) : Field(comm) {
+    hBuckets = vBuckets = NULL;
+}
+
 void FieldTranspose::init() {
     Field::init();
 
@@ -21,23 +25,17 @@ void FieldTranspose::init() {
 }
 
 FieldTranspose::~FieldTranspose() {
-    delete[] sendcounts;
-    delete[] recvcounts;
-    delete[] senddispls;
-    delete[] recvdispls;
-    delete[] gathercounts;
-    delete[] gatherdispls;
-    for (size_t i = 0; i < numProcs; ++i) {
-        MPI_Type_free(sendtypes + i);
-        MPI_Type_free(recvtypes + i);
+    if (hBuckets == NULL) {
+        return;
     }
-    delete[] sendtypes;
-    delete[] recvtypes;
 
-    delete[] weights;
-    delete[] weightsT;
+    delete[] hBuckets;
+    delete[] vBuckets;
+    delete[] gathercounts;
+    delete[] gatherdispls;
 
-    MPI_Comm_free(&balanceComm);
+    algo::arena().release(weights);
+    algo::arena().release(weightsT);
 }
 
 void FieldTranspose::calculateNBS() {
@@ -51,88 +49,58 @@ void FieldTranspose::calculateNBS() {
     mySY = mySYT = height * myCoord;
     mySX = 0;
 
-    heightCapacity = height;
+    // Buffers are created once and reused by the following repeats
+    if (hBuckets == NULL) {
+        hBuckets = new size_t[numProcs];
+        vBuckets = new size_t[numProcs];
+        nextBuckets.resize(numProcs);
+        nextBucketsT.resize(numProcs);
 
-    hBuckets = new size_t[numProcs];
-    vBuckets = new size_t[numProcs];
-    nextBuckets.resize(numProcs);
-    nextBucketsT.resize(numProcs);
-    for (size_t i = 0; i < numProcs; ++i) {
-        hBuckets[i] = vBuckets[i] = nextBuckets[i] = nextBucketsT[i] = (int)height;
-    }
+        gathercounts = new int[numProcs];
+        gatherdispls = new int[numProcs];
 
-    sendcounts = new int[numProcs];
-    senddispls = new int[numProcs];
-    recvcounts = new int[numProcs];
-    recvdispls = new int[numProcs];
-    gathercounts = new int[numProcs];
-    gatherdispls = new int[numProcs];
-    sendtypes = new MPI_Datatype[numProcs];
-    recvtypes = new MPI_Datatype[numProcs];
+        weights = algo::arena().allocDoubles(Arena::kOther, width);
+        weightsT = algo::arena().allocDoubles(Arena::kOther, width);
+    }
 
     for (size_t i = 0; i < numProcs; ++i) {
-        sendcounts[i] = recvcounts[i] = 1;
-        senddispls[i] = i == 0 ? 0 : (int)(senddispls[i - 1] + hBuckets[i - 1] * sizeof(double));
-        recvdispls[i] = i == 0 ? 0 : (int)(recvdispls[i - 1] + vBuckets[i - 1] * sizeof(double));
-
-        createVType(width, vBuckets[myCoord], hBuckets[i], sendtypes + i);
-        createHType(width, hBuckets[myCoord], vBuckets[i], recvtypes + i);
+        hBuckets[i] = vBuckets[i] = nextBuckets[i] = nextBucketsT[i] = (int)height;
     }
 
-    weights = new double[width];
     memset(weights, 0, width * sizeof(double));
-    weightsT = new double[width];
     memset(weightsT, 0, width * sizeof(double));
-
-    MPI_Comm_dup(comm, &balanceComm);
 }
 
 #pragma mark - Logic
 
 void FieldTranspose::transpose() {
-    transpose(transposed ? curr : prev);
+    // Balancing may give this rank more rows than before
+    reserve(hBuckets[myCoord] * pitch);
+    transpose(transposed ? &curr : &prev);
 
     std::swap(hX, hY);
     std::swap(mySY, mySYT);
     std::swap(hBuckets, vBuckets);
-    std::swap(senddispls, recvdispls);
-    std::swap(sendtypes, recvtypes);
     std::swap(nextBuckets, nextBucketsT);
     std::swap(weights, weightsT);
 
     transposed = transposed == false;
 }
 
+void FieldTranspose::updateWeight(size_t row, size_t iterationsCount, double time) {
+    if (transposed ^ balanceTransposed) {
+        weights[mySY + row] = weights[mySY + row] * algo::ftr().TransposeBalanceFactor()
+                + iterationsCount * (1.0 - algo::ftr().TransposeBalanceTimeFactor())
+                + time * algo::ftr().TransposeBalanceTimeFactor();
+    }
+}
+
 size_t FieldTranspose::solveRows() {
     //debug(0).flush();
 
     START_TIME(start);
-    
-    size_t maxIterationsCount = 0;
-
-    for (size_t row = 0; row < height; ++row) {
-        fillFactors(row, true);
-        double delta = solve(row, true);
-        size_t iterationsCount = 1;
-        auto startTime = picosecFromStart();
-
-        while (delta > epsilon) {
-            fillFactors(row, false);
-            delta = solve(row, false);
-            ++iterationsCount;
-
-            if (iterationsCount > MAX_ITTERATIONS_COUNT) {
-                break;
-            }
-        }
-        //debug() << "Write to " << mySY + row << " of " << width << "\n";
-        if (transposed ^ balanceTransposed) {
-            weights[mySY + row] = weights[mySY + row] * algo::ftr().TransposeBalanceFactor()
-                    + iterationsCount * (1.0 - algo::ftr().TransposeBalanceTimeFactor())
-                    + (picosecFromStart() - startTime) * 1e-12 * algo::ftr().TransposeBalanceTimeFactor();
-        }
-        maxIterationsCount = std::max(maxIterationsCount, iterationsCount);
-    }
+
+    size_t maxIterationsCount = solveIndependentRows();
 
     END_TIME(transposed ? x2Time : x1Time, start);
 
@@ -151,7 +119,7 @@ double FieldTranspose::view(double x1, double x2) {
         return NOTHING;
     }
 
-    return curr[x2index * width + x1index];
+    return curr[x2index * pitch + x1index];
 }
 
 void FieldTranspose::printConsole() {
@@ -174,10 +142,9 @@ void FieldTranspose::printMatrix() {
                 }
                 mfout = new std::ofstream("matrix.csv", std::ios::app);
 
-                size_t index = 0;
                 for (size_t row = 0; row < height; ++row) {
-                    for (size_t col = 0; col < width; ++col, ++index) {
-                        *mfout << curr[index];
+                    for (size_t col = 0; col < width; ++col) {
+                        *mfout << curr[row * pitch + col];
                         if (col < width - 1) {
                             *mfout << " ";
                         }
@@ -192,102 +159,27 @@ void FieldTranspose::printMatrix() {
                 delete mfout;
                 mfout = NULL;
             }
-            MPI_Barrier(comm);
+            comm->barrier();
         }
     }
 }
 
 #pragma mark - MPI
 
-void FieldTranspose::transpose(double *arr) {
-    //resize(hBuckets[myCoord]);
-    memcpy(buff, arr, height * width * sizeof(double));
+void FieldTranspose::transpose(double **arr) {
     height = hBuckets[myCoord];
 
-    //debug() << "Alltoallw\n";
-
-    /*for (size_t i = 0; i < numProcs; ++i) {
-        int sendsize, recvsize;
-        char sendbuff[255], recvbuff[255];
-        MPI_Type_get_name(sendtypes[i], sendbuff, &sendsize);
-        MPI_Type_get_name(recvtypes[i], recvbuff, &recvsize);
-        MPI_Type_size(sendtypes[i], &sendsize);
-        MPI_Type_size(recvtypes[i], &recvsize);
-
-        debug() << "to: " << i << " count: " << sendcounts[i] << " disp: " << senddispls[i] << " size: " << sendsize / 8 << " name: " << sendbuff
-        <<" | " << "from: " << i << " count: " << recvcounts[i] << " disp: " << recvdispls[i] << " size: " << recvsize / 8  << " name: " << recvbuff << "\n";
-    }*/
-
+    // Transposed layer goes to `buff`, which takes the place of the layer
     START_TIME(start);
-    MPI_Alltoallw(buff, sendcounts, senddispls, sendtypes, arr, recvcounts, recvdispls, recvtypes, comm);
+    comm->transpose(*arr, buff, pitch, vBuckets, hBuckets);
     END_TIME(syncNetworkTime, start);
+    std::swap(*arr, buff);
 
     //debug() << "OK height: " << height << "\n";
 }
 
 #pragma mark - Balancing
 
-void FieldTranspose::resize(size_t newHeight) {
-    if (newHeight <= heightCapacity) {
-        return;
-    }
-
-    while (heightCapacity < newHeight) {
-        heightCapacity = heightCapacity * 10;
-    }
-
-    memcpy(buff, prev, width * height * sizeof(double));
-    delete[] prev;
-    prev = new double[heightCapacity * width];
-    memcpy(prev, buff, width * height * sizeof(double));
-
-    memcpy(buff, curr, width * height * sizeof(double));
-    delete[] curr;
-    curr = new double[heightCapacity * width];
-    memcpy(curr, buff, width * height * sizeof(double));
-
-    delete[] buff;
-    buff = new double[heightCapacity * width];
-
-    delete[] maF;
-    delete[] mbF;
-    delete[] mcF;
-    delete[] mfF;
-
-    maF = new double[heightCapacity * width];
-    mbF = new double[heightCapacity * width];
-    mcF = new double[heightCapacity * width];
-    mfF = new double[heightCapacity * width];
-
-    //debug() << "NEW HEIGHT " << heightCapacity << "\n";
-}
-
-void FieldTranspose::createVType(size_t width, size_t height, size_t bWidth, MPI_Datatype *type) {
-    MPI_Datatype mpi_retmp_type;
-    MPI_Datatype mpi_col_type;
-
-    MPI_Type_vector((int)height, (int)1, (int)width, MPI_DOUBLE, &mpi_retmp_type);
-
-    MPI_Type_create_resized(mpi_retmp_type, 0, (int)1 * sizeof(double), &mpi_col_type);
-    MPI_Type_free(&mpi_retmp_type);
-
-    MPI_Type_contiguous((int)bWidth, mpi_col_type, type);
-    //MPI_Type_set_name(*type, "V_Block");
-    MPI_Type_commit(type);
-    MPI_Type_free(&mpi_col_type);
-}
-
-void FieldTranspose::createHType(size_t width, size_t height, size_t bWidth, MPI_Datatype *type) {
-    MPI_Datatype mpi_tmp_type;
-
-    MPI_Type_vector((int)height, (int)bWidth, (int)width, MPI_DOUBLE, &mpi_tmp_type);
-
-    MPI_Type_create_resized(mpi_tmp_type, 0, (int)height * sizeof(double), type);
-    //MPI_Type_set_name(*type, "H_Block");
-    MPI_Type_commit(type);
-    MPI_Type_free(&mpi_tmp_type);
-}
-
 void FieldTranspose::syncWeights() {
     if (algo::ftr().Balancing()) {
         START_TIME(startG);
@@ -299,7 +191,7 @@ void FieldTranspose::syncWeights() {
             //debug() << "SWW ..." << " " << myId << " " << i << " " << height << " " << gathercounts[i] << " " << gatherdispls[i] << "\n";
         }
         
-        MPI_Gatherv(weights + mySY, (int)height, MPI_DOUBLE, weights, gathercounts, gatherdispls, MPI_DOUBLE, MASTER, balanceComm);
+        comm->gather(weights + mySY, height, weights, gathercounts, gatherdispls, MASTER);
 
         END_TIME(syncWeightsTime, startG);
 
@@ -313,7 +205,7 @@ void FieldTranspose::syncWeights() {
         }
 
         START_TIME(startB);
-        MPI_Bcast(&nextBucketsT[0], (int)numProcs, MPI_INT, MASTER, balanceComm);
+        comm->broadcast(&nextBucketsT[0], numProcs, MASTER);
         END_TIME(syncWeightsTime, startB);
 
         if (bfout != NULL) {
@@ -385,15 +277,6 @@ void FieldTranspose::balance() {
         if (i < myCoord) {
             mySYT += hBuckets[i];
         }
-        
-        senddispls[i] = i == 0 ? 0 : (int)(senddispls[i - 1] + hBuckets[i - 1] * sizeof(double));
-        recvdispls[i] = i == 0 ? 0 : (int)(recvdispls[i - 1] + vBuckets[i - 1] * sizeof(double));
-
-        MPI_Type_free(sendtypes + i);
-        MPI_Type_free(recvtypes + i);
-
-        createVType(width, vBuckets[myCoord], hBuckets[i], sendtypes + i);
-        createHType(width, hBuckets[myCoord], vBuckets[i], recvtypes + i);
 
         /*debug() << "PROC " << myCoord << " V:" << vBuckets[myCoord] << "x" << hBuckets[i]
                                       << " H:" << hBuckets[myCoord] << "x" << vBuckets[i]
@@ -422,8 +305,9 @@ void FieldTranspose::printTimeHeaders() {
             << "," << "sync-weights-time"
             << "," << "balancing-time"
             << "," << "partitioning-time"
-            << "," << "weights-smooth-time"
-            << "\n";
+            << "," << "weights-smooth-time";
+        printMemoryHeaders();
+        *tfout << "\n";
 
         fullIterationTime = calculationsTime = x1Time = x2Time = syncWeightsTime =
             syncNetworkTime = balancingTime = partitioningTime = weightsSmoothTime = 0;
@@ -440,8 +324,9 @@ void FieldTranspose::printTimes() {
             << "," << syncWeightsTime
             << "," << balancingTime
             << "," << partitioningTime
-            << "," << weightsSmoothTime
-            << "\n";
+            << "," << weightsSmoothTime;
+        printMemory();
+        *tfout << "\n";
 
         tfout->flush();
 
@@ -9,23 +9,21 @@
 
 class FieldTranspose : public Field {
 
-    MPI_Comm balanceComm;
-
     int balancingCounter;
 
     size_t mySYT;
     size_t *hBuckets, *vBuckets;
     std::vector<int> nextBuckets, nextBucketsT;
 
-    MPI_Datatype *sendtypes, *recvtypes;
-    int *sendcounts, *senddispls, *recvcounts, *recvdispls, *gathercounts, *gatherdispls;
+    int *gathercounts, *gatherdispls;
 
-    void transpose(double *arr);
+    void transpose(double **arr);
     void transpose() override;
 
     void calculateNBS() override;
 
     size_t solveRows() override;
+    void updateWeight(size_t row, size_t iterationsCount, double time) override;
 
     void printConsole() override;
     void printMatrix() override;
@@ -35,12 +33,6 @@ class FieldTranspose : public Field {
     double *weightsT;
     bool balanceTransposed;
 
-    size_t heightCapacity;
-    void resize(size_t newHeight);
-
-    void createVType(size_t width, size_t height, size_t bWidth, MPI_Datatype *type);
-    void createHType(size_t width, size_t height, size_t bWidth, MPI_Datatype *type);
-
     void syncWeights() override;
     bool balanceNeeded() override;
     void balance() override;
@@ -56,6 +48,7 @@ class FieldTranspose : public Field {
     void printTimes() override;
 
 public:
+    explicit FieldTranspose(Communicator *comm);
     ~FieldTranspose();
 
     void init() override;
@@ -13,32 +13,53 @@ int const NOTHING = -1;
 
 size_t const MAX_ITTERATIONS_COUNT = 50;
 
-Field::Field() {
+Field::Field(Communicator *comm) {
     fout = NULL;
     mfout = NULL;
     bfout = NULL;
+    wfout = NULL;
+    tfout = NULL;
+
+    this->comm = comm;
+    capacity = 0;
+    prev = curr = buff = views = NULL;
+    coefficientsMatrix.aF = coefficientsMatrix.bF = coefficientsMatrix.cF = coefficientsMatrix.fF = NULL;
+    pool = NULL;
+    finishedRepeats = 0;
+
+    for (size_t o = 0; o < 2; ++o) {
+        for (size_t k = 0; k < kMaxPredictorOrder; ++k) {
+            predictorLayers[o][k].values = NULL;
+        }
+    }
 }
 
 Field::~Field() {
-    if (fout != NULL) {
-        fout->close();
-        delete fout;
+    std::ofstream *streams[] = {fout, mfout, bfout, wfout, tfout};
+    for (size_t i = 0; i < 5; ++i) {
+        if (streams[i] != NULL) {
+            streams[i]->close();
+            delete streams[i];
+        }
     }
 
-    if (mfout != NULL) {
-        mfout->close();
-        delete mfout;
+    algo::arena().release(prev);
+    algo::arena().release(curr);
+    algo::arena().release(buff);
+    algo::arena().release(views);
+
+    freeCoefficients(coefficientsMatrix);
+
+    delete pool;
+    for (size_t i = 0; i < workspaces.size(); ++i) {
+        freeWorkspace(workspaces[i]);
     }
-    
-    delete[] prev;
-    delete[] curr;
-    delete[] buff;
-    delete[] views;
 
-    delete[] maF;
-    delete[] mbF;
-    delete[] mcF;
-    delete[] mfF;
+    for (size_t o = 0; o < 2; ++o) {
+        for (size_t k = 0; k < kMaxPredictorOrder; ++k) {
+            algo::arena().release(predictorLayers[o][k].values);
+        }
+    }
 }
 
 void Field::init() {
@@ -50,23 +71,31 @@ void Field::init() {
     dT = algo::ftr().totalTime() / algo::ftr().TimeSplitCount();
     epsilon = algo::ftr().Epsilon();
     transposed = false;
-    fout = NULL;
-    mfout = NULL;
-    bfout = NULL;
-    wfout = NULL;
-    tfout = NULL;
 
     calculateNBS();
+    pitch = Arena::rowStride(width);
 
-    prev = new double[width * width];
-    curr = new double[width * width];
-    buff = new double[width * width];
-    views = new double[algo::ftr().ViewCount()];
+    algo::arena().setNodeBinding(algo::ftr().EnableNumaBinding());
 
-    maF = new double[width * width];
-    mbF = new double[width * width];
-    mcF = new double[width * width];
-    mfF = new double[width * width];
+    // Local block with halo, plus headroom for rows received by balancing
+    size_t rows = height;
+    if (algo::ftr().Balancing()) {
+        rows = (size_t)ceil(rows * algo::ftr().BalanceHeadroom());
+    }
+    reserve(rows * pitch);
+
+    // Row sized buffers are allocated once and reused by the following repeats
+    if (views == NULL) {
+        views = algo::arena().allocDoubles(Arena::kOther, algo::ftr().ViewCount());
+
+        workspaces.resize(algo::ftr().Threads());
+        for (size_t i = 0; i < workspaces.size(); ++i) {
+            allocWorkspace(workspaces[i]);
+        }
+        if (workspaces.size() > 1) {
+            pool = new WorkPool(workspaces.size());
+        }
+    }
 
     fillInitial();
 
@@ -89,84 +118,614 @@ void Field::init() {
     debug(0).flush();
 }
 
+void Field::allocWorkspace(Workspace &w) {
+    // Rows of transposed static field may grow up to width + halo after balancing.
+    // Buffers are rows of one block at a padded stride, so they do not share cache sets.
+    size_t rowSize = width + numProcs;
+    size_t rowStride = Arena::rowStride(rowSize);
+    w.lmF = algo::arena().allocRows(Arena::kRows, 6, rowSize);
+    w.rcF = w.lmF + rowStride;
+    w.pF = w.rcF + rowStride;
+    w.qF = w.pF + rowStride;
+    w.dlmF = w.qF + rowStride;
+    w.drcF = w.dlmF + rowStride;
+
+    // Independent rows are solved one by one, so one row of coefficients is enough
+    w.rowScratch = allocCoefficients(width + numProcs);
+
+    // Properties cache of the rows being solved, one row per batch lane
+    size_t cacheSize = algo::kBatchLanes * width;
+    w.cacheT = algo::arena().allocRows(Arena::kRows, 3, cacheSize);
+    w.cacheLm = w.cacheT + Arena::rowStride(cacheSize);
+    w.cacheRc = w.cacheLm + Arena::rowStride(cacheSize);
+
+    w.baF = algo::allocBatch(width);
+    w.bbF = algo::allocBatch(width);
+    w.bcF = algo::allocBatch(width);
+    w.bfF = algo::allocBatch(width);
+    w.bY = algo::allocBatch(width);
+
+    w.mixers = NULL;
+    if (algo::ftr().NonlinearSolver() == kNonlinearAnderson) {
+        w.mixers = new Anderson[algo::kBatchLanes];
+        for (size_t lane = 0; lane < algo::kBatchLanes; ++lane) {
+            w.mixers[lane].init(algo::ftr().AndersonDepth(), width + numProcs);
+        }
+    }
+
+    w.guess = NULL;
+    if (algo::ftr().PredictorOrder() > 0 && algo::ftr().EnablePredictorBaseline()) {
+        w.guess = algo::arena().allocDoubles(Arena::kPredictor, algo::kBatchLanes * (width + numProcs));
+    }
+
+    w.calculationsTime = 0;
+    w.rowIterations = w.maxIterationsCount = 0;
+    w.sampledRows = w.sampledIterations = w.baselineIterations = 0;
+}
+
+void Field::freeWorkspace(Workspace &w) {
+    // Row buffers and caches are rows of one block each
+    algo::arena().release(w.lmF);
+    freeCoefficients(w.rowScratch);
+    algo::arena().release(w.cacheT);
+    algo::arena().release(w.guess);
+
+    algo::freeBatch(w.baF);
+    algo::freeBatch(w.bbF);
+    algo::freeBatch(w.bcF);
+    algo::freeBatch(w.bfF);
+    algo::freeBatch(w.bY);
+
+    delete[] w.mixers;
+}
+
+void Field::reserve(size_t size) {
+    if (size <= capacity) {
+        return;
+    }
+
+    size_t newCapacity = std::max(size, capacity + capacity / 2);
+
+    double *values = allocBlock(Arena::kLayers, newCapacity);
+    if (prev != NULL) {
+        memcpy(values, prev, capacity * sizeof(double));
+    }
+    algo::arena().release(prev);
+    prev = values;
+
+    values = allocBlock(Arena::kLayers, newCapacity);
+    if (curr != NULL) {
+        memcpy(values, curr, capacity * sizeof(double));
+    }
+    algo::arena().release(curr);
+    curr = values;
+
+    algo::arena().release(buff);
+    buff = allocBlock(Arena::kLayers, newCapacity);
+
+    if (keepsCoefficients()) {
+        freeCoefficients(coefficientsMatrix);
+        coefficientsMatrix = allocCoefficients(newCapacity);
+    }
+
+    // Predictor history is in the old layout anyway
+    for (size_t o = 0; o < 2; ++o) {
+        predictorCount[o] = 0;
+        for (size_t k = 0; k < kMaxPredictorOrder; ++k) {
+            algo::arena().release(predictorLayers[o][k].values);
+            predictorLayers[o][k].values = NULL;
+        }
+    }
+
+    capacity = newCapacity;
+}
+
+double *Field::allocBlock(Arena::Category category, size_t count) {
+    double *values = algo::arena().allocDoubles(category, count, algo::ftr().EnableHugePages());
+    touchRows(values, count);
+    return values;
+}
+
+void Field::touchRows(double *values, size_t count) {
+    // Every row of the block is solved by this rank, in order
+    for (size_t index = 0; index < count; index += pitch) {
+        memset(values + index, 0, std::min<size_t>(pitch, count - index) * sizeof(double));
+    }
+}
+
 void Field::fillInitial() {
     t = 0;
     nextFrameTime = 0;
     lastIterrationsCount = 0;
     fullProcessingTime = 0;
+    predictorCount[0] = predictorCount[1] = 0;
+    rowSteps = rowStepsRows = rowIterations = predictedSteps = 0;
+    sampledRows = sampledIterations = baselineIterations = 0;
     if (transposed) {
         transpose();
     }
 
-    for (size_t index = 0, len = width * height; index < len; ++index) {
-        curr[index] = algo::ftr().TStart();
+    for (size_t row = 0; row < height; ++row) {
+        std::fill(curr + row * pitch, curr + row * pitch + width, algo::ftr().TStart());
     }
 }
 
 void Field::transpose() {
 }
 
+bool Field::keepsCoefficients() {
+    return false;
+}
+
+Field::RowCoefficients Field::allocCoefficients(size_t size) {
+    RowCoefficients k;
+    size_t const kPerDouble = sizeof(double) / sizeof(algo::coefficient_t);
+#ifdef COEFFICIENTS_AOS
+    k.aF = (algo::coefficient_t *)allocBlock(Arena::kCoefficients, (size * algo::kCoefficientsStride + kPerDouble - 1) / kPerDouble);
+    k.bF = k.aF + 1;
+    k.cF = k.aF + 2;
+    k.fF = k.aF + 3;
+#else
+    // Separate arrays are rows of one block, padded apart in cache sets
+    size_t stride = Arena::rowStride((size + kPerDouble - 1) / kPerDouble) * kPerDouble;
+    k.aF = (algo::coefficient_t *)allocBlock(Arena::kCoefficients, 4 * stride / kPerDouble);
+    k.bF = k.aF + stride;
+    k.cF = k.bF + stride;
+    k.fF = k.cF + stride;
+#endif
+    return k;
+}
+
+void Field::freeCoefficients(RowCoefficients &k) {
+    algo::arena().release(k.aF);
+    k.aF = k.bF = k.cF = k.fF = NULL;
+}
+
 void Field::nextTimeLayer() {
     std::swap(curr, prev);
     t += dT;
 }
 
-void Field::fillFactors(size_t row, bool first) {
+void Field::prepareLiquid() {
+    if (algo::ftr().EnableLiquidRows() == false || leftN != NOBODY) {
+        return;
+    }
+    if (liquidFactors.hX != hX || liquidFactors.dT != dT || liquidFactors.cF.size() != width) {
+        algo::factorLiquid(liquidFactors, width, hX, dT);
+    }
+}
+
+size_t Field::liquidEquations(const double *brw) {
+    if (algo::ftr().EnableLiquidRows() == false || leftN != NOBODY) {
+        return 0;
+    }
+
+    size_t liquid = algo::liquidEquations(brw, width);
+    if (rightN != NOBODY) {
+        // Halo of the right neighbour is not eliminated here
+        liquid = std::min(liquid, width - 2);
+    }
+    return liquid;
+}
+
+void Field::resetPropertiesCache(Workspace &w, size_t lane) {
+    std::fill(w.cacheT + lane * width, w.cacheT + (lane + 1) * width, NAN);
+}
+
+Field::RowCoefficients Field::coefficients(size_t row) {
+    size_t offset = row * pitch * algo::kCoefficientsStride;
+    const RowCoefficients &m = coefficientsMatrix;
+    RowCoefficients k = { m.aF + offset, m.bF + offset, m.cF + offset, m.fF + offset };
+    return k;
+}
+
+size_t Field::fillFactors(Workspace &w, const RowCoefficients &k, size_t row, bool first, bool newton, bool cached) {
     START_TIME(start);
     
-    double *aF = maF + row * width;
-    double *bF = mbF + row * width;
-    double *cF = mcF + row * width;
-    double *fF = mfF + row * width;
+    algo::coefficient_t *aF = k.aF, *bF = k.bF, *cF = k.cF, *fF = k.fF;
+
+    double *rw = prev + row * pitch;
+    double *brw = first ? rw : (curr + row * pitch);
+
+    size_t liquid = liquidEquations(brw);
+    size_t stride = algo::kCoefficientsStride;
+    algo::fillLiquid(liquidFactors, rw, brw, liquid, aF, bF, cF, fF, stride);
+
+    if (newton) {
+        algo::fillNewtonFactors(rw, brw, width, aF, bF, cF, fF, w.lmF, w.rcF, w.dlmF, w.drcF,
+                                rowK, leftN == NOBODY, rightN == NOBODY, stride, liquid);
+    } else if (cached) {
+        algo::fillFactors(rw, brw, width, aF, bF, cF, fF, w.cacheLm, w.cacheRc, rowK,
+                          leftN == NOBODY, rightN == NOBODY, stride, liquid, w.cacheT);
+    } else {
+        algo::fillFactors(rw, brw, width, aF, bF, cF, fF, w.lmF, w.rcF, rowK,
+                          leftN == NOBODY, rightN == NOBODY, stride, liquid);
+    }
+
+    END_TIME(w.calculationsTime, start);
+
+    return liquid;
+}
 
-    double *rw = prev + row * width;
-    double *brw = first ? rw : (curr + row * width);
+void Field::firstPass(Workspace &w, const RowCoefficients &k, size_t from) {
+    START_TIME(start);
 
-    algo::fillFactors(rw, brw, width, aF, bF, cF, fF, t, hX, dT, leftN == NOBODY, rightN == NOBODY);
+    algo::firstPass(width, k.aF, k.bF, k.cF, k.fF, rightN == NOBODY, from);
 
-    END_TIME(calculationsTime, start);
+    END_TIME(w.calculationsTime, start);
 }
 
-void Field::firstPass(size_t row) {
+double Field::secondPass(Workspace &w, const RowCoefficients &k, size_t row, bool first) {
     START_TIME(start);
 
-    double *aF = maF + row * width;
-    double *bF = mbF + row * width;
-    double *cF = mcF + row * width;
-    double *fF = mfF + row * width;
+    double *y = curr + row * pitch;
+    double *py = first ? (prev + row * pitch) : y;
+
+    double maxDelta = 0;
+    algo::secondPass(py, y, width, k.bF, k.cF, k.fF, rightN == NOBODY, &maxDelta);
+
+    END_TIME(w.calculationsTime, start);
 
-    algo::firstPass(width, aF, bF, cF, fF, rightN == NOBODY);
+    return maxDelta;
+}
 
-    END_TIME(calculationsTime, start);
+double Field::solve(Workspace &w, const RowCoefficients &k, size_t row, bool first, size_t from) {
+    firstPass(w, k, from);
+    return secondPass(w, k, row, first);
 }
 
-double Field::secondPass(size_t row, bool first) {
+double Field::solveFused(Workspace &w, size_t row, bool first, bool seed) {
     START_TIME(start);
 
-    double *bF = mbF + row * width;
-    double *cF = mcF + row * width;
-    double *fF = mfF + row * width;
+    double *rw = prev + row * pitch;
+    double *y = curr + row * pitch;
+    double *py = first ? rw : y;
 
-    double *y = curr + row * width;
-    double *py = first ? (prev + row * width) : y;
+    if (seed) {
+        algo::fillProperties(py, width, w.lmF, w.rcF);
+    }
 
     double maxDelta = 0;
-    algo::secondPass(py, y, width, bF, cF, fF, rightN == NOBODY, &maxDelta);
+    algo::fusedFirstPass(rw, py, width, w.lmF, w.rcF, w.pF, w.qF, rowK);
+    algo::fusedSecondPass(py, y, width, w.pF, w.qF, w.lmF, w.rcF, &maxDelta);
 
-    END_TIME(calculationsTime, start);
+    END_TIME(w.calculationsTime, start);
 
     return maxDelta;
 }
 
-double Field::solve(size_t row, bool first) {
-    firstPass(row);
-    return secondPass(row, first);
+size_t Field::solveRow(Workspace &w, size_t row, bool predicted) {
+    bool newtonSolver = algo::ftr().NonlinearSolver() == kNonlinearNewton;
+    bool anderson = algo::ftr().NonlinearSolver() == kNonlinearAnderson;
+    // Fused kernel is plain Picard and keeps properties between iterations, so it needs both borders
+    bool fused = algo::ftr().NonlinearSolver() == kNonlinearPicard && algo::ftr().EnableFusedRows()
+            && leftN == NOBODY && rightN == NOBODY;
+
+    // Predicted rows start from the guess in `curr` instead of `prev`
+    bool first = predicted == false;
+
+    bool cached = algo::ftr().EnablePropertiesCache();
+    if (cached) {
+        resetPropertiesCache(w, 0);
+    }
+
+    double *y = curr + row * pitch;
+    if (anderson) {
+        w.mixers[0].start(first ? (prev + row * pitch) : y, width);
+    }
+
+    double delta = 0;
+    if (fused) {
+        delta = solveFused(w, row, first, true);
+    } else {
+        size_t liquid = fillFactors(w, w.rowScratch, row, first, newtonSolver, cached);
+        delta = solve(w, w.rowScratch, row, first, liquid);
+    }
+    if (anderson) {
+        w.mixers[0].mix(y);
+    }
+    size_t iterationsCount = 1;
+    w.weightStart = picosecFromStart();
+
+    bool newton = newtonSolver;
+    double lastDelta = delta;
+    while (delta > epsilon) {
+        if (fused) {
+            delta = solveFused(w, row, false, false);
+        } else {
+            size_t liquid = fillFactors(w, w.rowScratch, row, false, newton, cached);
+            delta = solve(w, w.rowScratch, row, false, liquid);
+        }
+        if (anderson) {
+            w.mixers[0].mix(y);
+        }
+        ++iterationsCount;
+
+        // Newton steps are taken only while they converge, otherwise fall back to Picard
+        newton = newtonSolver && delta <= lastDelta;
+        lastDelta = delta;
+
+        if (iterationsCount > MAX_ITTERATIONS_COUNT) {
+            break;
+        }
+    }
+
+    return iterationsCount;
+}
+
+void Field::solveBatch(Workspace &w, size_t fromRow, size_t count, size_t *iterationsCounts, bool predicted) {
+    // Rows [fromRow, fromRow + count) are solved together, one per lane.
+    // Spare lanes repeat the last row and stay inactive.
+    const size_t lanes = algo::kBatchLanes;
+    size_t rows[algo::kBatchLanes];
+    algo::batch_mask_t active = {};
+
+    bool newtonSolver = algo::ftr().NonlinearSolver() == kNonlinearNewton;
+    bool anderson = algo::ftr().NonlinearSolver() == kNonlinearAnderson;
+    bool cached = algo::ftr().EnablePropertiesCache();
+    bool newton[algo::kBatchLanes];
+    double lastDelta[algo::kBatchLanes];
+
+    for (size_t lane = 0; lane < lanes; ++lane) {
+        rows[lane] = fromRow + std::min(lane, count - 1);
+        iterationsCounts[lane] = 0;
+        newton[lane] = newtonSolver;
+        lastDelta[lane] = 0;
+        if (lane < count) {
+            active[lane] = -1;
+        }
+
+        // Predicted rows start from the guess in `curr` instead of `prev`
+        double *y0 = (predicted ? curr : prev) + rows[lane] * pitch;
+        for (size_t index = 0; index < width; ++index) {
+            w.bY[index][lane] = y0[index];
+        }
+        if (anderson) {
+            w.mixers[lane].start(y0, width);
+        }
+        if (cached) {
+            resetPropertiesCache(w, lane);
+        }
+    }
+
+    bool first = predicted == false;
+    bool firstRound = true;
+    bool solving = true;
+    while (solving) {
+        START_TIME(start);
+
+        // Elimination starts at the shortest liquid prefix, longer ones have zero `aF`
+        size_t from = width;
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            if (firstRound == false && active[lane] == 0) {
+                continue;
+            }
+
+            double *rw = prev + rows[lane] * pitch;
+            double *brw = first ? rw : (curr + rows[lane] * pitch);
+            double *aF = (double *)w.baF + lane, *bF = (double *)w.bbF + lane;
+            double *cF = (double *)w.bcF + lane, *fF = (double *)w.bfF + lane;
+
+            size_t liquid = liquidEquations(brw);
+            algo::fillLiquid(liquidFactors, rw, brw, liquid, aF, bF, cF, fF, lanes);
+            from = std::min(from, liquid);
+
+            if (newton[lane]) {
+                algo::fillNewtonFactors(rw, brw, width, aF, bF, cF, fF,
+                                        w.lmF, w.rcF, w.dlmF, w.drcF, rowK, leftN == NOBODY, rightN == NOBODY, lanes, liquid);
+            } else if (cached) {
+                size_t offset = lane * width;
+                algo::fillFactors(rw, brw, width, aF, bF, cF, fF,
+                                  w.cacheLm + offset, w.cacheRc + offset, rowK,
+                                  leftN == NOBODY, rightN == NOBODY, lanes, liquid, w.cacheT + offset);
+            } else {
+                algo::fillFactors(rw, brw, width, aF, bF, cF, fF,
+                                  w.lmF, w.rcF, rowK, leftN == NOBODY, rightN == NOBODY, lanes, liquid);
+            }
+        }
+
+        algo::batch_t maxDelta;
+        algo::firstPassBatch(width, w.baF, w.bbF, w.bcF, w.bfF, rightN == NOBODY, from);
+        algo::secondPassBatch(w.bY, width, w.bbF, w.bcF, w.bfF, rightN == NOBODY, active, &maxDelta);
+
+        solving = false;
+        for (size_t lane = 0; lane < count; ++lane) {
+            if (active[lane] == 0) {
+                continue;
+            }
+
+            double *y = curr + rows[lane] * pitch;
+            for (size_t index = 0; index < width; ++index) {
+                y[index] = w.bY[index][lane];
+            }
+            if (anderson) {
+                w.mixers[lane].mix(y);
+                for (size_t index = 0; index < width; ++index) {
+                    w.bY[index][lane] = y[index];
+                }
+            }
+
+            ++iterationsCounts[lane];
+            if (firstRound == false) {
+                newton[lane] = newtonSolver && maxDelta[lane] <= lastDelta[lane];
+            }
+            lastDelta[lane] = maxDelta[lane];
+
+            if (maxDelta[lane] > epsilon && iterationsCounts[lane] <= MAX_ITTERATIONS_COUNT) {
+                solving = true;
+            } else {
+                active[lane] = 0;
+            }
+        }
+        END_TIME(w.calculationsTime, start);
+
+        if (firstRound) {
+            w.weightStart = picosecFromStart();
+        }
+        first = false;
+        firstRound = false;
+    }
+}
+
+size_t Field::solveIndependentRows() {
+    bool predicted = predict();
+
+    ++rowSteps;
+    rowStepsRows += height;
+    if (predicted) {
+        ++predictedSteps;
+    }
+
+    // Items are batches or single rows, counts go to the workspace of the worker
+    bool batched = algo::ftr().EnableBatchedRows();
+    bool baseline = predicted && algo::ftr().EnablePredictorBaseline();
+    size_t itemRows = batched ? algo::kBatchLanes : 1;
+    size_t items = (height + itemRows - 1) / itemRows;
+
+    auto solveItem = [this, batched, predicted, baseline](size_t item, size_t worker) {
+        Workspace &w = workspaces[worker];
+        size_t row = batched ? item * algo::kBatchLanes : item;
+        size_t count = batched ? std::min(algo::kBatchLanes, height - row) : 1;
+
+        bool sampled = baseline && item % kPredictorSampleStride == 0;
+        if (sampled) {
+            w.baselineIterations += solveBaseline(w, row, count, batched);
+            w.sampledRows += count;
+        }
+
+        if (batched) {
+            size_t iterationsCounts[algo::kBatchLanes];
+
+            solveBatch(w, row, count, iterationsCounts, predicted);
+
+            // Batch time is shared between rows by their iterations
+            double batchTime = (picosecFromStart() - w.weightStart) * 1e-12;
+            size_t batchIterations = 0;
+            for (size_t lane = 0; lane < count; ++lane) {
+                batchIterations += iterationsCounts[lane];
+            }
+            w.rowIterations += batchIterations;
+            if (sampled) {
+                w.sampledIterations += batchIterations;
+            }
+            for (size_t lane = 0; lane < count; ++lane) {
+                updateWeight(row + lane, iterationsCounts[lane], batchTime * iterationsCounts[lane] / batchIterations);
+                w.maxIterationsCount = std::max(w.maxIterationsCount, iterationsCounts[lane]);
+            }
+        } else {
+            size_t iterationsCount = solveRow(w, row, predicted);
+            updateWeight(row, iterationsCount, (picosecFromStart() - w.weightStart) * 1e-12);
+            w.maxIterationsCount = std::max(w.maxIterationsCount, iterationsCount);
+            w.rowIterations += iterationsCount;
+            if (sampled) {
+                w.sampledIterations += iterationsCount;
+            }
+        }
+    };
+
+    if (pool != NULL) {
+        pool->run(items, solveItem);
+    } else {
+        for (size_t item = 0; item < items; ++item) {
+            solveItem(item, 0);
+        }
+    }
+
+    size_t maxIterationsCount = 0;
+    for (size_t i = 0; i < workspaces.size(); ++i) {
+        Workspace &w = workspaces[i];
+        maxIterationsCount = std::max(maxIterationsCount, w.maxIterationsCount);
+        rowIterations += w.rowIterations;
+        sampledRows += w.sampledRows;
+        sampledIterations += w.sampledIterations;
+        baselineIterations += w.baselineIterations;
+        w.maxIterationsCount = w.rowIterations = 0;
+        w.sampledRows = w.sampledIterations = w.baselineIterations = 0;
+    }
+    return maxIterationsCount;
+}
+
+size_t Field::solveBaseline(Workspace &w, size_t row, size_t count, bool batched) {
+    // Baseline is not part of the step, its time is left out
+    bx_time_sp calculationsTime = w.calculationsTime;
+    for (size_t lane = 0; lane < count; ++lane) {
+        memcpy(w.guess + lane * width, curr + (row + lane) * pitch, width * sizeof(double));
+    }
+
+    size_t iterations = 0;
+    if (batched) {
+        size_t iterationsCounts[algo::kBatchLanes];
+        solveBatch(w, row, count, iterationsCounts, false);
+        for (size_t lane = 0; lane < count; ++lane) {
+            iterations += iterationsCounts[lane];
+        }
+    } else {
+        iterations = solveRow(w, row, false);
+    }
+
+    for (size_t lane = 0; lane < count; ++lane) {
+        memcpy(curr + (row + lane) * pitch, w.guess + lane * width, width * sizeof(double));
+    }
+    w.calculationsTime = calculationsTime;
+    return iterations;
+}
+
+bool Field::predict() {
+    size_t order = algo::ftr().PredictorOrder();
+    if (order == 0) {
+        return false;
+    }
+
+    // Half steps of one orientation are 2 * dT apart, each keeps own layers in own layout
+    PredictorLayer *layers = predictorLayers[transposed ? 1 : 0];
+    size_t &count = predictorCount[transposed ? 1 : 0];
+    size_t len = height * pitch;
+
+    bool valid = count >= order;
+    for (size_t k = 0; valid && k < order; ++k) {
+        valid = layers[k].height == height && layers[k].mySY == mySY;
+    }
+
+    if (valid) {
+        START_TIME(start);
+        double *p1 = layers[0].values;
+        if (order == 1) {
+            for (size_t index = 0; index < len; ++index) {
+                curr[index] = 1.5 * prev[index] - 0.5 * p1[index];
+            }
+        } else {
+            double *p2 = layers[1].values;
+            for (size_t index = 0; index < len; ++index) {
+                curr[index] = 1.875 * prev[index] - 1.25 * p1[index] + 0.375 * p2[index];
+            }
+        }
+        END_TIME(calculationsTime, start);
+    }
+
+    // Oldest layer is reused for the newest one
+    PredictorLayer oldest = layers[order - 1];
+    for (size_t k = order - 1; k > 0; --k) {
+        layers[k] = layers[k - 1];
+    }
+    if (oldest.values == NULL) {
+        oldest.values = allocBlock(Arena::kPredictor, capacity);
+    }
+    memcpy(oldest.values, prev, len * sizeof(double));
+    oldest.height = height;
+    oldest.mySY = mySY;
+    layers[0] = oldest;
+    count = std::min(count + 1, order);
+
+    return valid;
 }
 
 size_t Field::solveRows() {
     return 0;
 }
 
+void Field::updateWeight(size_t row, size_t iterationsCount, double time) {
+}
+
 void Field::solve() {
     if (done()) {
         return;
@@ -177,6 +736,8 @@ void Field::solve() {
     lastIterrationsCount = 0;
 
     nextTimeLayer();
+    rowK = algo::rowConstants(t, hX, dT);
+    prepareLiquid();
     lastIterrationsCount += solveRows();
     if (balanceNeeded()) {
         syncWeights();
@@ -185,6 +746,8 @@ void Field::solve() {
 
     nextTimeLayer();
     transpose();
+    rowK = algo::rowConstants(t, hX, dT);
+    prepareLiquid();
     lastIterrationsCount += solveRows();
     if (balanceNeeded()) {
         syncWeights();
@@ -193,6 +756,12 @@ void Field::solve() {
 
     transpose();
 
+    // Time of workers is summed, so with threads it may exceed the wall time
+    for (size_t i = 0; i < workspaces.size(); ++i) {
+        calculationsTime += workspaces[i].calculationsTime;
+        workspaces[i].calculationsTime = 0;
+    }
+
     END_TIME(fullIterationTime, solveStart);
 
     printAll();
@@ -10,6 +10,11 @@
 #include <vector>
 #include <chrono>
 
+#include "algo.h"
+#include "anderson.h"
+#include "pool.h"
+#include "comm.h"
+
 extern int const MASTER;
 extern int const WAITER;
 extern int const NOBODY;
@@ -31,30 +36,114 @@ protected:
     double nextFrameTime;
 
     double *prev, *curr, *buff, *views;
-    double *maF, *mbF, *mcF, *mfF;
+
+    struct RowCoefficients {
+        algo::coefficient_t *aF, *bF, *cF, *fF;
+    };
+
+    /**
+     *  Matrix of every row, `coefficientsMatrix`, is allocated only when `keepsCoefficients`.
+     *  It uses the `algo::kCoefficientsStride` layout, as does `rowScratch` of a workspace.
+     */
+    RowCoefficients coefficientsMatrix;
+
+    RowCoefficients allocCoefficients(size_t size);
+    void freeCoefficients(RowCoefficients &k);
+
+    /**
+     *  Scratch of one thread solving rows. Rows solved to convergence one at a time share `rowScratch`.
+     *  Workspace 0 belongs to the main thread, which also uses it for passes of the static algorithm.
+     */
+    struct Workspace {
+        RowCoefficients rowScratch;
+        double *lmF, *rcF, *dlmF, *drcF, *pF, *qF;
+        double *cacheT, *cacheLm, *cacheRc;
+        algo::batch_t *baF, *bbF, *bcF, *bfF, *bY;
+        Anderson *mixers;
+
+        // Predicted guess of sampled rows while they are solved from `prev`, one row per batch lane
+        double *guess;
+
+        // Time row weights are taken from, right after the first iteration of the last row or batch
+        unsigned long long weightStart;
+
+        // Folded into the counters of the field by the main thread
+        bx_time_sp calculationsTime;
+        size_t rowIterations, maxIterationsCount;
+        size_t sampledRows, sampledIterations, baselineIterations;
+    };
+
+    std::vector<Workspace> workspaces;
+    WorkPool *pool;
+
+    // Repeats finished by `finalize`, the memory report follows the last one
+    size_t finishedRepeats;
+
+    void allocWorkspace(Workspace &w);
+    void freeWorkspace(Workspace &w);
+
+    algo::LiquidFactors liquidFactors;
 
     size_t width, height, origWidth, origHeight;
+
+    /**
+     *  Rows of `prev`, `curr`, `buff` and predictor layers are `pitch` values apart, `Arena::rowStride`
+     *  of the row length, so that every row starts on a cache line.
+     */
+    size_t pitch;
+    size_t capacity;
     bool transposed;
 
     double t;
     double hX, hY, dT;
+    algo::RowConstants rowK;
     double epsilon;
     size_t lastIterrationsCount;
 
     int myId, numProcs, myCoord;
-    MPI_Comm comm;
+    Communicator *comm;
     size_t mySX, mySY;
     int topN, bottomN, leftN, rightN;
 
+    /**
+     *  Grows field and coefficient arrays to hold `size` values, keeping `prev` and `curr`.
+     */
+    void reserve(size_t size);
+
+    /**
+     *  Array sized by the local block. Its rows are touched first by their owner, so that
+     *  pages are placed where the rows are solved.
+     */
+    double *allocBlock(Arena::Category category, size_t count);
+    void touchRows(double *values, size_t count);
     void fillInitial();
     virtual void calculateNBS();
 
-    void fillFactors(size_t row, bool first);
-    void firstPass(size_t row);
-    double secondPass(size_t row, bool first);
-    double solve(size_t row, bool first);
+    /**
+     *  Liquid factors are refreshed here, so threads only read them from `liquidEquations`.
+     */
+    void prepareLiquid();
+    size_t liquidEquations(const double *brw);
+    void resetPropertiesCache(Workspace &w, size_t lane);
+    virtual bool keepsCoefficients();
+    RowCoefficients coefficients(size_t row);
+
+    size_t fillFactors(Workspace &w, const RowCoefficients &k, size_t row, bool first, bool newton = false, bool cached = false);
+    void firstPass(Workspace &w, const RowCoefficients &k, size_t from = 1);
+    double secondPass(Workspace &w, const RowCoefficients &k, size_t row, bool first);
+    double solve(Workspace &w, const RowCoefficients &k, size_t row, bool first, size_t from = 1);
+    double solveFused(Workspace &w, size_t row, bool first, bool seed);
+    size_t solveRow(Workspace &w, size_t row, bool predicted);
+    void solveBatch(Workspace &w, size_t fromRow, size_t count, size_t *iterationsCounts, bool predicted);
+
+    /**
+     *  Rows of the local block converge independently. With `Threads` above one they are
+     *  handed out to the work stealing pool, by one row or by one batch.
+     */
+    size_t solveIndependentRows();
 
     virtual size_t solveRows();
+    virtual void updateWeight(size_t row, size_t iterationsCount, double time);
 
     virtual void transpose();
     void nextTimeLayer();
@@ -75,6 +164,34 @@ protected:
 
     void reduceViews();
 
+#pragma mark - Predictor
+
+    static size_t const kMaxPredictorOrder = 2;
+
+    /**
+     *  With `EnablePredictorBaseline` every `kPredictorSampleStride`-th row or batch of predicted steps
+     *  is also solved from `prev`, so iterations saved by the predictor are counted against the same step.
+     */
+    static size_t const kPredictorSampleStride = 16;
+
+    struct PredictorLayer {
+        double *values;
+        size_t height, mySY;
+    };
+
+    PredictorLayer predictorLayers[2][kMaxPredictorOrder];
+    size_t predictorCount[2];
+    size_t rowSteps, rowStepsRows, rowIterations, predictedSteps;
+    size_t sampledRows, sampledIterations, baselineIterations;
+
+    /**
+     *  Solves `count` rows from `row` as if they were not predicted and restores their guess.
+     *  @return iterations of the rows
+     */
+    size_t solveBaseline(Workspace &w, size_t row, size_t count, bool batched);
+
+    bool predict();
+
 #pragma mark - Balancing MPI
 
     double *weights;
@@ -95,9 +212,18 @@ protected:
     virtual void printTimeHeaders();
     virtual void printTimes();
 
+    /**
+     *  Columns of current and peak bytes of every arena category, appended to a times row.
+     */
+    void printMemoryHeaders();
+    void printMemory();
+
 public:
-    Field();
-    ~Field();
+    /**
+     *  @param comm ranks the field is split between, it is not owned by the field
+     */
+    explicit Field(Communicator *comm);
+    virtual ~Field();
     virtual void finalize();
 
     void test();
@@ -4,11 +4,13 @@
 
 #include <stdio.h>
 #include <mpi.h>
+#include <thread>
 
 #include "field-static.h"
 #include "field-transpose.h"
 #include "factors.h"
 #include "algo.h"
+#include "comm.h"
 
 #ifndef ALGV
 #define ALGV 0
@@ -126,41 +128,94 @@ void initConfig(int argc, char * argv[]) {
     MPI_Comm_rank(MPI_COMM_WORLD, &id);
     for (size_t p = 0; p < procs; ++p) {
         if (p == id) {
-            algo::ftr().initFactors(configFilename);
+            algo::initFactors(configFilename);
         }
         MPI_Barrier(MPI_COMM_WORLD);
     }
+
+    if (id == 0 && algo::ftr().EnablePropertiesTable()) {
+        printf("Properties table\tstep: %.5f\tmax error: %.2e\n",
+               algo::ftr().PropertiesTableStep(), algo::ftr().PropertiesTableError());
+    }
+}
+
+void runField(Communicator *comm) {
+    Field *field = NULL;
+    if (algo::ftr().Algorithm() == kAlgorithmTranspose) {
+        field = new FieldTranspose(comm);
+    } else if (algo::ftr().Algorithm() == kAlgorithmStatic) {
+        field = new FieldStatic(comm);
+    }
+
+    for (size_t k = 0; k < algo::ftr().Repeats(); ++k) {
+        field->init();
+
+        while (field->done() == false) {
+            field->solve();
+        }
+
+        field->finalize();
+    }
+
+    delete field;
 }
 
 int main(int argc, char * argv[]) {
-    MPI_Init(&argc, &argv);
+    // Row threads do not call MPI. A progress thread does, but never with the main thread at once
+    int provided = 0;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_SERIALIZED, &provided);
 
     initConfig(argc, argv);
 
-    auto startTime = bx_clock_t::now();
-    {
-        Field *field = NULL;
-        if (algo::ftr().Algorithm() == kAlgorithmTranspose) {
-            field = new FieldTranspose;
-        } else if (algo::ftr().Algorithm() == kAlgorithmStatic) {
-            field = new FieldStatic;
-        }
+    int myRank, procs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+    MPI_Comm_size(MPI_COMM_WORLD, &procs);
 
-        for (size_t k = 0; k < algo::ftr().Repeats(); ++k) {
-            field->init();
+    // Pipeline of the static algorithm does not wait for the compute loop to take its messages
+    bool progress = algo::ftr().EnableProgressThread() && algo::ftr().Algorithm() == kAlgorithmStatic
+            && algo::ftr().Backend() == kBackendMpi;
+    if (progress && provided < MPI_THREAD_SERIALIZED) {
+        if (myRank == 0) {
+            std::cerr << "MPI does not allow the progress thread\n";
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
 
-            while (field->done() == false) {
-                field->solve();
+    auto startTime = bx_clock_t::now();
+    if (algo::ftr().Backend() == kBackendThreads) {
+        // Every process would solve the whole field on its own
+        if (procs > 1) {
+            if (myRank == 0) {
+                std::cerr << "Backend 1 runs in one process\n";
             }
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
 
-            field->finalize();
+        // Thread ranks do not call MPI, rank 0 is the main thread
+        SharedWorld world(algo::ftr().Ranks());
+        std::vector<SharedCommunicator> comms;
+        for (size_t r = 0; r < world.Ranks(); ++r) {
+            comms.push_back(SharedCommunicator(world, (int)r));
         }
 
-        delete field;
+        std::vector<std::thread> ranks;
+        for (size_t r = 1; r < world.Ranks(); ++r) {
+            ranks.push_back(std::thread(runField, &comms[r]));
+        }
+        runField(&comms[0]);
+        for (size_t r = 0; r < ranks.size(); ++r) {
+            ranks[r].join();
+        }
+    } else {
+        MpiCommunicator comm(MPI_COMM_WORLD);
+        if (progress) {
+            ProgressCommunicator progressComm(&comm, FieldStatic::messageSize(procs));
+            runField(&progressComm);
+        } else {
+            runField(&comm);
+        }
     }
 
-    int myRank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
     MPI_Barrier(MPI_COMM_WORLD);
     auto picosecCount = std::chrono::duration<unsigned long long, std::pico>(bx_clock_t::now() - startTime).count();
     if (myRank == 0) {
@@ -0,0 +1,151 @@
+//
+//  Copyright © 2016 Nikolay Volosatov. All rights reserved.
+//
+
+#include "pool.h"
+#include <algorithm>
+
+static inline uint64_t packRange(uint64_t begin, uint64_t end) {
+    return end << 32 | begin;
+}
+
+static inline size_t rangeBegin(uint64_t bounds) {
+    return (size_t)(bounds & 0xffffffffu);
+}
+
+static inline size_t rangeEnd(uint64_t bounds) {
+    return (size_t)(bounds >> 32);
+}
+
+WorkPool::WorkPool(size_t workers) : ranges(std::max<size_t>(workers, 1)) {
+    this->workers = ranges.size();
+    steals = 0;
+    generation = running = 0;
+    stopping = false;
+    job = NULL;
+
+    for (size_t worker = 0; worker < this->workers; ++worker) {
+        ranges[worker].bounds = 0;
+    }
+    for (size_t worker = 1; worker < this->workers; ++worker) {
+        threads.push_back(std::thread(&WorkPool::loop, this, worker));
+    }
+}
+
+WorkPool::~WorkPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    started.notify_all();
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+}
+
+size_t WorkPool::Workers() const {
+    return workers;
+}
+
+size_t WorkPool::Steals() const {
+    return steals;
+}
+
+void WorkPool::run(size_t count, const Job &job) {
+    if (count == 0) {
+        return;
+    }
+
+    for (size_t worker = 0; worker < workers; ++worker) {
+        ranges[worker].bounds = packRange(count * worker / workers, count * (worker + 1) / workers);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->job = &job;
+        running = workers - 1;
+        ++generation;
+    }
+    started.notify_all();
+
+    work(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return running == 0; });
+    this->job = NULL;
+}
+
+bool WorkPool::take(size_t worker, size_t *item) {
+    std::atomic<uint64_t> &bounds = ranges[worker].bounds;
+    uint64_t current = bounds.load();
+    while (rangeBegin(current) < rangeEnd(current)) {
+        if (bounds.compare_exchange_weak(current, packRange(rangeBegin(current) + 1, rangeEnd(current)))) {
+            *item = rangeBegin(current);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool WorkPool::steal(size_t worker) {
+    while (true) {
+        // Victim with the most items left
+        size_t victim = workers, most = 0;
+        for (size_t other = 0; other < workers; ++other) {
+            uint64_t current = ranges[other].bounds.load();
+            size_t left = rangeEnd(current) - std::min(rangeBegin(current), rangeEnd(current));
+            if (other != worker && left > most) {
+                victim = other;
+                most = left;
+            }
+        }
+        if (victim == workers) {
+            return false;
+        }
+
+        std::atomic<uint64_t> &bounds = ranges[victim].bounds;
+        uint64_t current = bounds.load();
+        size_t begin = rangeBegin(current), end = rangeEnd(current);
+        if (begin >= end) {
+            continue;
+        }
+        size_t middle = end - (end - begin + 1) / 2;
+        if (bounds.compare_exchange_strong(current, packRange(begin, middle))) {
+            // Own range is empty, thieves do not touch empty ranges
+            ranges[worker].bounds = packRange(middle, end);
+            ++steals;
+            return true;
+        }
+    }
+}
+
+void WorkPool::work(size_t worker) {
+    size_t item = 0;
+    do {
+        while (take(worker, &item)) {
+            (*job)(item, worker);
+        }
+    } while (steal(worker));
+}
+
+void WorkPool::loop(size_t worker) {
+    size_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            started.wait(lock, [this, seen] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+        }
+
+        work(worker);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --running;
+        }
+        finished.notify_one();
+    }
+}
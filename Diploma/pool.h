@@ -0,0 +1,71 @@
+//
+//  Copyright © 2016 Nikolay Volosatov. All rights reserved.
+//
+
+#ifndef pool_h
+#define pool_h
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ *  Persistent threads that run items `[0, count)` of a job. The calling thread is worker 0.
+ *
+ *  Every worker starts with an equal range of items and takes them from its front.
+ *  A worker that runs out steals the back half of the largest range left, so items that
+ *  take much longer than others (rows near the solidification front) do not leave workers idle.
+ */
+class WorkPool {
+public:
+    typedef std::function<void(size_t item, size_t worker)> Job;
+
+    explicit WorkPool(size_t workers);
+    ~WorkPool();
+
+    size_t Workers() const;
+
+    /**
+     *  Runs `job` for every item and returns when all of them are done.
+     */
+    void run(size_t count, const Job &job);
+
+    /**
+     *  Ranges stolen since the pool was created.
+     */
+    size_t Steals() const;
+
+private:
+    /**
+     *  Items `[begin, end)` of a worker packed as `end << 32 | begin`, so that the owner taking
+     *  from the front and thieves taking from the back agree through one compare-and-swap.
+     *  Padded to a cache line, workers do not share lines of their ranges.
+     */
+    struct Range {
+        std::atomic<uint64_t> bounds;
+        char padding[64 - sizeof(std::atomic<uint64_t>)];
+    };
+
+    size_t workers;
+    std::vector<Range> ranges;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> steals;
+
+    std::mutex mutex;
+    std::condition_variable started, finished;
+    size_t generation, running;
+    bool stopping;
+    const Job *job;
+
+    bool take(size_t worker, size_t *item);
+    bool steal(size_t worker);
+    void work(size_t worker);
+    void loop(size_t worker);
+};
+
+#endif /* pool_h */
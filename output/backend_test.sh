@@ -0,0 +1,37 @@
+#!/bin/bash
+# Compares MPI processes and threads of one process as ranks
+# usage: ./backend_test.sh [ranks] [split count] [max time]
+RANKS=${1:-4}
+SPLIT=${2:-500}
+TMAX=${3:-60}
+
+mpic++ --std=c++11 -march=native -O2 -pthread ../Diploma/*.cpp -o backend-test
+
+for algorithm in 0 1
+do
+    for backend in 0 1
+    do
+        sed -e "s/^Algorithm .*/Algorithm $algorithm/" \
+            -e "s/^Backend .*/Backend $backend/" \
+            -e "s/^Ranks .*/Ranks $RANKS/" \
+            -e "s/^X1SplitCount .*/X1SplitCount $SPLIT/" \
+            -e "s/^X2SplitCount .*/X2SplitCount $SPLIT/" \
+            -e "s/^TMax .*/TMax $TMAX/" \
+            -e "s/^EnablePlot .*/EnablePlot 0/" \
+            -e "s/^EnableBuckets .*/EnableBuckets 0/" \
+            -e "s/^EnableWeights .*/EnableWeights 0/" \
+            -e "s/^EnableTimes .*/EnableTimes 0/" \
+            -e "s/^EnableConsole .*/EnableConsole 0/" \
+            config.ini > backend-config.ini
+
+        # Thread ranks need no mpirun
+        if [ $backend -eq 0 ]; then
+            seconds=$(mpirun -np $RANKS ./backend-test backend-config.ini 2>&1 >/dev/null | tail -n 1)
+        else
+            seconds=$(./backend-test backend-config.ini 2>&1 >/dev/null | tail -n 1)
+        fi
+        echo -e "algorithm $algorithm\tbackend $backend\t$seconds"
+    done
+done
+
+rm -f backend-test backend-config.ini
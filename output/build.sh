@@ -1,2 +1,2 @@
 #!/bin/bash
-mpic++ --std=c++11 ../Diploma/* -o debug
+mpic++ --std=c++11 -march=native -pthread ../Diploma/* -o debug
@@ -0,0 +1,34 @@
+#!/bin/bash
+# Compares separate (SoA) and packed (COEFFICIENTS_AOS) coefficient layouts
+# usage: ./layout_test.sh [processes] [split count] [max time]
+PROCS=${1:-1}
+SPLIT=${2:-500}
+TMAX=${3:-60}
+
+mpic++ --std=c++11 -march=native -O2 ../Diploma/*.cpp -o layout-soa
+mpic++ --std=c++11 -march=native -O2 -DCOEFFICIENTS_AOS ../Diploma/*.cpp -o layout-aos
+
+# Batched and fused rows keep their own layouts, so rows go through firstPass and secondPass
+for algorithm in 0 1
+do
+    sed -e "s/^Algorithm .*/Algorithm $algorithm/" \
+        -e "s/^X1SplitCount .*/X1SplitCount $SPLIT/" \
+        -e "s/^X2SplitCount .*/X2SplitCount $SPLIT/" \
+        -e "s/^TMax .*/TMax $TMAX/" \
+        -e "s/^EnablePlot .*/EnablePlot 0/" \
+        -e "s/^EnableBuckets .*/EnableBuckets 0/" \
+        -e "s/^EnableWeights .*/EnableWeights 0/" \
+        -e "s/^EnableTimes .*/EnableTimes 0/" \
+        -e "s/^EnableConsole .*/EnableConsole 0/" \
+        -e "s/^EnableBatchedRows .*/EnableBatchedRows 0/" \
+        -e "s/^EnableFusedRows .*/EnableFusedRows 0/" \
+        config.ini > layout-config.ini
+
+    for layout in soa aos
+    do
+        seconds=$(mpirun -np $PROCS ./layout-$layout layout-config.ini 2>&1 >/dev/null | tail -n 1)
+        echo -e "algorithm $algorithm\t$layout\t$seconds"
+    done
+done
+
+rm -f layout-soa layout-aos layout-config.ini
@@ -0,0 +1,54 @@
+#!/bin/bash
+# Runs config.ini as is, then once with each optional mode turned on: time and max deviation from the first run
+# usage: ./modes_test.sh [processes] [algorithm]
+PROCS=${1:-1}
+ALGORITHM=${2:-1}
+
+mpic++ --std=c++11 -march=native -O2 -pthread ../Diploma/*.cpp -o modes-test
+
+# Modes are off in config.ini, every run turns one of them on
+MODES=(
+    "EnableBatchedRows 1"
+    "EnableFusedRows 1"
+    "EnablePropertiesTable 1"
+    "PredictorOrder 1"
+    "EnableLiquidRows 1"
+    "EnableColumnSweeps 1"
+    "EnableProgressThread 1"
+)
+
+# Max |a - b| over all points of the plot
+maxdiff() {
+    paste -d, "$1" "$2" | awk -F, '{
+        n = NF / 2
+        for (i = 2; i <= n; ++i) { d = $i - $(i + n); if (d < 0) d = -d; if (d > m) m = d }
+    } END { printf "%.6g\n", m }'
+}
+
+# usage: run name [key value]
+run() {
+    sed -e "s/^Algorithm .*/Algorithm $ALGORITHM/" \
+        -e "s/^EnablePlot .*/EnablePlot 1/" \
+        -e "s/^EnableBuckets .*/EnableBuckets 0/" \
+        -e "s/^EnableWeights .*/EnableWeights 0/" \
+        -e "s/^EnableTimes .*/EnableTimes 0/" \
+        -e "s/^EnableConsole .*/EnableConsole 0/" \
+        config.ini > modes-config.ini
+    if [ -n "$2" ]; then
+        sed -i "s/^$2 .*/$2 $3/" modes-config.ini
+    fi
+
+    seconds=$(mpirun -np $PROCS ./modes-test modes-config.ini 2>&1 >/dev/null | tail -n 1)
+    mv view.csv modes-$1.csv
+}
+
+run reference
+echo -e "reference\t$seconds"
+
+for mode in "${MODES[@]}"
+do
+    run mode $mode
+    echo -e "$mode\t$seconds\t$(maxdiff modes-mode.csv modes-reference.csv) K"
+done
+
+rm -f modes-test modes-config.ini modes-reference.csv modes-mode.csv
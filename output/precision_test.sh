@@ -0,0 +1,42 @@
+#!/bin/bash
+# Compares double and float (COEFFICIENTS_FLOAT) coefficient storage: time and max deviation of view.csv
+# usage: ./precision_test.sh [processes] [algorithm] [split count]
+PROCS=${1:-1}
+ALGORITHM=${2:-1}
+SPLIT=${3:-100}
+
+mpic++ --std=c++11 -march=native -O2 ../Diploma/*.cpp -o precision-double
+mpic++ --std=c++11 -march=native -O2 -DCOEFFICIENTS_FLOAT ../Diploma/*.cpp -o precision-float
+
+sed -e "s/^Algorithm .*/Algorithm $ALGORITHM/" \
+    -e "s/^X1SplitCount .*/X1SplitCount $SPLIT/" \
+    -e "s/^X2SplitCount .*/X2SplitCount $SPLIT/" \
+    -e "s/^EnablePlot .*/EnablePlot 1/" \
+    -e "s/^EnableBuckets .*/EnableBuckets 0/" \
+    -e "s/^EnableWeights .*/EnableWeights 0/" \
+    -e "s/^EnableTimes .*/EnableTimes 0/" \
+    -e "s/^EnableConsole .*/EnableConsole 0/" \
+    config.ini > precision-config.ini
+
+for precision in double float
+do
+    seconds=$(mpirun -np $PROCS ./precision-$precision precision-config.ini 2>&1 >/dev/null | tail -n 1)
+    mv view.csv precision-$precision.csv
+    echo -e "$precision\t$seconds"
+done
+
+# Max |float - double| over all points of the plot, test_view.csv is for the default split
+maxdiff() {
+    paste -d, "$1" "$2" | awk -F, '{
+        n = NF / 2
+        for (i = 2; i <= n; ++i) { d = $i - $(i + n); if (d < 0) d = -d; if (d > m) m = d }
+    } END { printf "%.6g\n", m }'
+}
+echo -e "float vs double\t$(maxdiff precision-float.csv precision-double.csv) K"
+if [ "$SPLIT" = "100" ]
+then
+    echo -e "double vs test_view.csv\t$(maxdiff precision-double.csv test_view.csv) K"
+    echo -e "float vs test_view.csv\t$(maxdiff precision-float.csv test_view.csv) K"
+fi
+
+rm -f precision-double precision-float precision-config.ini precision-double.csv precision-float.csv
@@ -0,0 +1,65 @@
+//
+//  Copyright © 2016 Nikolay Volosatov. All rights reserved.
+//
+
+// Compares the tiled algo::transpose with the element-wise loop it replaced
+// usage: ./transpose-bench [width] [height] [repeats]
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include "../Diploma/algo.h"
+
+typedef std::chrono::steady_clock bench_clock_t;
+
+static void transposeByElement(const double *src, double *dst, size_t height, size_t width) {
+    for (size_t index = 0, len = width * height; index < len; ++index) {
+        size_t newIndex = (index % width) * height + index / width;
+        dst[newIndex] = src[index];
+    }
+}
+
+template <typename Transpose>
+static double measure(Transpose transpose, double *a, double *b, size_t height, size_t width, size_t repeats) {
+    double best = 1e100;
+    for (size_t k = 0; k < repeats; ++k) {
+        bench_clock_t::time_point start = bench_clock_t::now();
+        // Back and forth, as the field is transposed twice per time step
+        transpose(a, b, height, width);
+        transpose(b, a, width, height);
+        best = std::min(best, std::chrono::duration<double>(bench_clock_t::now() - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char * argv[]) {
+    size_t width = argc > 1 ? atol(argv[1]) : 1500;
+    size_t height = argc > 2 ? atol(argv[2]) : width;
+    size_t repeats = argc > 3 ? atol(argv[3]) : 20;
+
+    size_t len = width * height;
+    double *a = algo::arena().allocDoubles(Arena::kOther, len);
+    double *b = algo::arena().allocDoubles(Arena::kOther, len);
+    std::vector<double> expected(len);
+    for (size_t index = 0; index < len; ++index) {
+        a[index] = index;
+    }
+    transposeByElement(a, expected.data(), height, width);
+    algo::transpose(a, b, height, width);
+    for (size_t index = 0; index < len; ++index) {
+        if (b[index] != expected[index]) {
+            printf("mismatch at %zu\n", index);
+            return 1;
+        }
+    }
+
+    double element = measure(transposeByElement, a, b, height, width, repeats);
+    double tiled = measure(algo::transpose, a, b, height, width, repeats);
+    printf("%zux%zu\telement: %.3f ms\ttiled: %.3f ms\tspeedup: %.2f\n",
+           width, height, element * 1e3, tiled * 1e3, element / tiled);
+
+    algo::arena().release(a);
+    algo::arena().release(b);
+    return 0;
+}
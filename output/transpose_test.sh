@@ -0,0 +1,13 @@
+#!/bin/bash
+# Times FieldStatic local transpose, element-wise and tiled, on square and halo-sized blocks
+# usage: ./transpose_test.sh [width] [repeats]
+WIDTH=${1:-1500}
+REPEATS=${2:-20}
+
+mpic++ --std=c++11 -march=native -O2 transpose_bench.cpp $(ls ../Diploma/*.cpp | grep -v main.cpp) -o transpose-bench
+
+./transpose-bench $WIDTH $WIDTH $REPEATS
+./transpose-bench $WIDTH $((WIDTH / 4 + 2)) $REPEATS
+./transpose-bench $((WIDTH / 4 + 1)) $WIDTH $REPEATS
+
+rm -f transpose-bench